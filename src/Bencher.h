@@ -1,13 +1,14 @@
 #ifndef SCHROEDINGER_BENCHER_H
 #define SCHROEDINGER_BENCHER_H
 
+#include <chrono>
 #include <iostream>
 #include <map>
 #include <stdio.h>
 #include <string>
-#include <time.h>
 
-/// A simple stopwatch for benchmarking.
+/// A simple stopwatch for benchmarking. It measures wall time, as the CPU time
+/// of the process adds up the time of all the solver's threads.
 class Bencher {
 public:
   explicit Bencher(bool active = true);
@@ -17,17 +18,18 @@ public:
   void print();
 
 private:
+  typedef std::chrono::steady_clock Clock;
   bool active_;
-  clock_t prevTicks_ = clock();
+  Clock::time_point prevTicks_ = Clock::now();
   std::map<std::string, int> count_;
-  std::map<std::string, clock_t> ticks_;
+  std::map<std::string, Clock::duration> ticks_;
 };
 
 /// Create a new Bencher. If active_ is false, the Bencher will ignore all calls
 /// to the bench, restart and print methods.
 Bencher::Bencher(bool active) : active_(active) {
   if (active_) {
-    prevTicks_ = clock();
+    prevTicks_ = Clock::now();
   }
 }
 
@@ -40,10 +42,10 @@ void Bencher::bench(std::string s) {
   if (active_) {
     if (count_.find(s) == count_.end()) {
       count_[s] = 0;
-      ticks_[s] = 0;
+      ticks_[s] = Clock::duration::zero();
     }
     count_[s]++;
-    ticks_[s] += clock() - prevTicks_;
+    ticks_[s] += Clock::now() - prevTicks_;
     restart();
   }
 }
@@ -51,17 +53,19 @@ void Bencher::bench(std::string s) {
 /// Restart the stopwatch.
 inline void Bencher::restart() {
   if (active_) {
-    prevTicks_ = clock();
+    prevTicks_ = Clock::now();
   }
 }
 
-/// Print the average time of all samples taken, for each category.
+/// Print the average time of all samples taken, in ms, for each category.
 void Bencher::print() {
   if (active_) {
     for (auto itr = count_.begin(); itr != count_.end(); itr++) {
       if (itr->second > 0) {
         std::string s = itr->first;
-        std::cout << s << ": " << ticks_[s] / count_[s] << std::endl;
+        const std::chrono::duration<double, std::milli> average =
+            ticks_[s] / count_[s];
+        std::cout << s << ": " << average.count() << " ms" << std::endl;
       }
     }
   }
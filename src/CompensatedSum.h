@@ -0,0 +1,43 @@
+#ifndef SCHROEDINGER_COMPENSATEDSUM_H
+#define SCHROEDINGER_COMPENSATEDSUM_H
+
+#include <cmath>
+
+/// A sum of floating point numbers that keeps track of the rounding errors,
+/// using Neumaier's variant of Kahan summation. Its error does not grow with
+/// the number of terms.
+///
+/// As it is several times slower than plain addition, it is best used to add
+/// up partial sums, e.g. of the rows of a field.
+class CompensatedSum {
+public:
+  /// Add the given number.
+  void add(double x);
+  /// Add the value of the given sum.
+  void add(const CompensatedSum &other);
+  /// The sum of everything added so far.
+  double value() const;
+
+private:
+  double sum_ = 0;
+  double compensation_ = 0;
+};
+
+inline void CompensatedSum::add(double x) {
+  const double t = sum_ + x;
+  if (std::abs(sum_) >= std::abs(x)) {
+    compensation_ += (sum_ - t) + x;
+  } else {
+    compensation_ += (x - t) + sum_;
+  }
+  sum_ = t;
+}
+
+inline void CompensatedSum::add(const CompensatedSum &other) {
+  add(other.sum_);
+  add(other.compensation_);
+}
+
+inline double CompensatedSum::value() const { return sum_ + compensation_; }
+
+#endif // SCHROEDINGER_COMPENSATEDSUM_H
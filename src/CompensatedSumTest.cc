@@ -0,0 +1,44 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestFixture.h>
+
+#include "CompensatedSum.h"
+
+class CompensatedSumTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(CompensatedSumTest);
+  CPPUNIT_TEST(testSum);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void testSum();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CompensatedSumTest);
+
+void CompensatedSumTest::testSum() {
+  // Plain addition loses the 1 next to 1e16.
+  CPPUNIT_ASSERT_EQUAL(0.0, 1e16 + 1.0 - 1e16);
+  CompensatedSum sum;
+  sum.add(1e16);
+  sum.add(1.0);
+  sum.add(-1e16);
+  CPPUNIT_ASSERT_EQUAL(1.0, sum.value());
+  // Kahan summation would lose these, as the large term comes second.
+  CompensatedSum neumaier;
+  neumaier.add(1.0);
+  neumaier.add(1e100);
+  neumaier.add(1.0);
+  neumaier.add(-1e100);
+  CPPUNIT_ASSERT_EQUAL(2.0, neumaier.value());
+  // Merging partial sums keeps both their compensations.
+  CompensatedSum first;
+  first.add(1e16);
+  first.add(1.0);
+  CompensatedSum second;
+  second.add(1.0);
+  second.add(-1e16);
+  second.add(1.0);
+  first.add(second);
+  CPPUNIT_ASSERT_EQUAL(3.0, first.value());
+}
@@ -3,6 +3,12 @@
 
 #include <cstring>
 #include <cassert>
+#include <climits>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include "ThreadPool.h"
 
 enum BoundaryCondition {
   WRAP,   ///< Wrap toroidally:     6 7|3 4 5 6 7|3 4
@@ -10,6 +16,19 @@ enum BoundaryCondition {
   ZERO,   ///< Set edges to zero:   0 0|3 4 5 6 7|0 0
 };
 
+/// A read-only view of the cells of a Field, including its border. The cell
+/// (x, y) is at origin[x + y * stride], for -border <= x < width + border and
+/// -border <= y < height + border.
+template <typename T> struct FieldView {
+  const T *origin; ///< The first cell of the main rectangle.
+  int width;       ///< Width of the main rectangle.
+  int height;      ///< Height of the main rectangle.
+  int stride;      ///< The distance between two rows, in cells.
+  int border;      ///< Size of the border.
+  /// Get the value at point (x, y).
+  T get(int x, int y) const { return origin[x + y * stride]; }
+};
+
 /// A rectangular grid of cells of type T, for use as a cellular automaton.
 /// The rectangle has a border of a configurable width, that frames the grid
 /// itself. After writing values into the rectangle, the wrap() method populates
@@ -29,18 +48,28 @@ enum BoundaryCondition {
 /// f.get(6, -1) == 'x';
 /// f.get(1, 9) == 'x';
 /// f.get(6, 9) == 'x';
+///
+/// If a ThreadPool is given, the frame is first written by the pool's workers,
+/// each of them zeroing the band of rows it will handle in later sweeps. On
+/// NUMA systems, this places each band's memory on its worker's node.
 template <typename T> class Field {
 public:
   const int width;            ///< Width of the main rectangle.
   const int height;           ///< Height of the main rectangle.
   const int border;           ///< Size of the border.
   BoundaryCondition boundary; ///< Boundary condition.
+  /// Number of cells in the frame. Computed first, so that no frame whose cells
+  /// cannot be indexed by an int is ever allocated.
+  const int framesize = checkedFrameSize(width, height, border);
   /// Width of the frame: main rectangle plus border-sized border.
   const int framew = 2 * border + width;
   /// Height of the frame: main rectangle plus border-sized border.
   const int frameh = 2 * border + height;
-  const int framesize = framew * frameh;
-  Field(int width_, int height_, int border_, BoundaryCondition boundary_);
+  /// Whether a field of the given size can be created: its frame is not empty
+  /// and the byte size of the frame fits into an int.
+  static bool fits(int width, int height, int border);
+  Field(int width_, int height_, int border_, BoundaryCondition boundary_,
+        ThreadPool *pool_ = nullptr);
   ~Field();
   /// Get the value at point (x, y), where the distance from (x, y) to the main
   /// rectangle is not greater than border.
@@ -62,26 +91,57 @@ public:
   T sum() const;
   /// Add the given value to every cell.
   void add(T t);
+  /// The extended frame, including the border: framesize cells, row by row.
+  const T *frame() const;
+  /// A view of the cells. It remains valid as long as the field exists.
+  FieldView<T> view() const;
 
 private:
+  // The frame size, throwing std::length_error unless fits().
+  static int checkedFrameSize(int width, int height, int border);
   void wrap();
   void mirror();
-  // The extended frame, including the border.
-  T *const data = new T[framesize];
+  // Call f(firstRow, lastRow) for the rows of the frame, in bands if there is
+  // a pool.
+  template <typename F> void forFrameRows(F f);
+  // The pool whose bands the rows are assigned to, or nullptr.
+  ThreadPool *const pool;
+  // The extended frame, including the border. The memory is not touched until
+  // zero() is called, so that the first write determines the page placement.
+  T *const data = static_cast<T *>(::operator new(sizeof(T) * framesize));
   // The first cell of the main rectangle.
   T *const cell0 = data + border * framew + border;
 };
 
 template <typename T>
 Field<T>::Field(int width_, int height_, int border_,
-                BoundaryCondition boundary_)
-    : width(width_), height(height_), border(border_), boundary(boundary_) {
+                BoundaryCondition boundary_, ThreadPool *pool_)
+    : width(width_), height(height_), border(border_), boundary(boundary_),
+      pool(pool_) {
   assert(boundary == ZERO || width >= border);
   assert(boundary == ZERO || height >= border);
   zero();
 }
 
-template <typename T> Field<T>::~Field() { delete[] data; }
+template <typename T>
+bool Field<T>::fits(int width, int height, int border) {
+  if (width <= 0 || height <= 0 || border < 0) {
+    return false;
+  }
+  const long long framew = 2LL * border + width;
+  const long long frameh = 2LL * border + height;
+  return framew <= static_cast<long long>(INT_MAX / sizeof(T)) / frameh;
+}
+
+template <typename T>
+int Field<T>::checkedFrameSize(int width, int height, int border) {
+  if (!fits(width, height, border)) {
+    throw std::length_error("Field: invalid or too large frame");
+  }
+  return (2 * border + width) * (2 * border + height);
+}
+
+template <typename T> Field<T>::~Field() { ::operator delete(data); }
 
 template <typename T> void Field<T>::fillBorder() {
   switch (boundary) {
@@ -97,7 +157,29 @@ template <typename T> void Field<T>::fillBorder() {
 }
 
 template <typename T> void Field<T>::zero() {
-  memset(data, 0, sizeof(T) * framesize);
+  forFrameRows([&](int firstRow, int lastRow) {
+    memset(data + firstRow * framew, 0,
+           sizeof(T) * (lastRow - firstRow) * framew);
+  });
+}
+
+template <typename T> template <typename F> void Field<T>::forFrameRows(F f) {
+  if (pool == nullptr) {
+    f(0, frameh);
+    return;
+  }
+  // Each band of the main rectangle's rows is handled by its own worker; the
+  // top and bottom border belong to the first and last band.
+  pool->forBands(0, height, [&](int band, int first, int last) {
+    f(band == 0 ? 0 : first + border,
+      band == pool->size() - 1 ? frameh : last + border);
+  });
+}
+
+template <typename T> inline const T *Field<T>::frame() const { return data; }
+
+template <typename T> inline FieldView<T> Field<T>::view() const {
+  return {cell0, width, height, framew, border};
 }
 
 template <typename T> void Field<T>::wrap() {
@@ -140,20 +222,46 @@ template <typename T> void Field<T>::mirror() {
 }
 
 template <typename T> T Field<T>::sum() const {
-  T result = 0;
-  for (int x = 0; x < width; x++) {
+  if (pool == nullptr) {
+    T result = 0;
     for (int y = 0; y < height; y++) {
-      result += cell0[x + y * framew];
+      for (int x = 0; x < width; x++) {
+        result += cell0[x + y * framew];
+      }
+    }
+    return result;
+  }
+  // Sum up each band separately, and add the results in a fixed order, so that
+  // the result does not depend on the scheduling.
+  std::vector<T> bandSums(pool->size(), 0);
+  pool->forBands(0, height, [&](int band, int first, int last) {
+    T result = 0;
+    for (int y = first; y < last; y++) {
+      for (int x = 0; x < width; x++) {
+        result += cell0[x + y * framew];
+      }
     }
+    bandSums[band] = result;
+  });
+  T result = 0;
+  for (T bandSum : bandSums) {
+    result += bandSum;
   }
   return result;
 }
 
 template <typename T> void Field<T>::add(T t) {
-  for (int x = 0; x < width; x++) {
-    for (int y = 0; y < height; y++) {
-      cell0[x + y * framew] += t;
+  auto addRows = [&](int, int first, int last) {
+    for (int y = first; y < last; y++) {
+      for (int x = 0; x < width; x++) {
+        cell0[x + y * framew] += t;
+      }
     }
+  };
+  if (pool == nullptr) {
+    addRows(0, 0, height);
+  } else {
+    pool->forBands(0, height, addRows);
   }
   wrap();
 }
@@ -240,7 +348,10 @@ template <typename T> void Field<T>::set(const Field<T> &other) {
   assert(other.width == width);
   assert(other.height == height);
   assert(other.border == border);
-  memcpy(data, other.data, framesize * sizeof(T));
+  forFrameRows([&](int firstRow, int lastRow) {
+    memcpy(data + firstRow * framew, other.data + firstRow * framew,
+           sizeof(T) * (lastRow - firstRow) * framew);
+  });
 }
 
 #endif // SCHROEDINGER_FIELD_H
@@ -1,4 +1,5 @@
 #include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/TestAssert.h>
 #include <cppunit/TestCaller.h>
 #include <cppunit/TestFixture.h>
@@ -11,12 +12,18 @@ class FieldTest : public CppUnit::TestFixture {
   CPPUNIT_TEST(testWrap);
   CPPUNIT_TEST(testMirror);
   CPPUNIT_TEST(testZero);
+  CPPUNIT_TEST(testPool);
+  CPPUNIT_TEST(testView);
+  CPPUNIT_TEST(testFits);
   CPPUNIT_TEST_SUITE_END();
 
 public:
   void testWrap();
   void testMirror();
   void testZero();
+  void testPool();
+  void testView();
+  void testFits();
 
 private:
   const int width = 5;
@@ -24,6 +31,8 @@ private:
   const int border = 2;
 };
 
+CPPUNIT_TEST_SUITE_REGISTRATION(FieldTest);
+
 void FieldTest::testWrap() {
   Field<int> field(width, height, border, WRAP);
   field.set(1, 2, 300);
@@ -84,11 +93,51 @@ void FieldTest::testZero() {
   CPPUNIT_ASSERT_EQUAL(0, field.get(4, 3));
 }
 
+void FieldTest::testPool() {
+  ThreadPool pool(2);
+  Field<int> field(width, height, border, WRAP, &pool);
+  Field<int> copy(width, height, border, WRAP, &pool);
+  CPPUNIT_ASSERT_EQUAL(0, field.get(-2, -2));
+  CPPUNIT_ASSERT_EQUAL(0, field.get(6, 4));
+  field.set(1, 2, 300);
+  field.set(4, 0, 500);
+  CPPUNIT_ASSERT_EQUAL(800, field.sum());
+  field.add(1);
+  CPPUNIT_ASSERT_EQUAL(815, field.sum());
+  copy.set(field);
+  CPPUNIT_ASSERT_EQUAL(301, copy.get(1, 2));
+  CPPUNIT_ASSERT_EQUAL(501, copy.get(-1, 3));
+  CPPUNIT_ASSERT_EQUAL(1, copy.get(6, 4));
+}
+
+void FieldTest::testView() {
+  Field<int> field(width, height, border, WRAP);
+  const FieldView<int> view = field.view();
+  CPPUNIT_ASSERT_EQUAL(width, view.width);
+  CPPUNIT_ASSERT_EQUAL(height, view.height);
+  CPPUNIT_ASSERT_EQUAL(width + 2 * border, view.stride);
+  CPPUNIT_ASSERT_EQUAL(border, view.border);
+  field.set(4, 0, 500);
+  field.fillBorder();
+  CPPUNIT_ASSERT_EQUAL(500, view.get(4, 0));
+  CPPUNIT_ASSERT_EQUAL(500, view.get(-1, 3));
+  CPPUNIT_ASSERT_EQUAL(500, view.origin[4]);
+}
+
+void FieldTest::testFits() {
+  CPPUNIT_ASSERT(Field<int>::fits(width, height, border));
+  CPPUNIT_ASSERT(!Field<int>::fits(0, height, border));
+  CPPUNIT_ASSERT(!Field<int>::fits(width, -1, border));
+  // The frame of 65540 * 65541 cells has more than INT_MAX cells.
+  CPPUNIT_ASSERT(!Field<char>::fits(65534, 65535, 3));
+  CPPUNIT_ASSERT(Field<char>::fits(46000, 46000, 3));
+  CPPUNIT_ASSERT(!Field<double>::fits(46000, 46000, 3));
+  CPPUNIT_ASSERT_THROW(Field<int>(65534, 65535, 3, WRAP), std::length_error);
+}
+
 int main(int argc, char **argv) {
-  CppUnit::TestSuite *suite = new CppUnit::TestSuite("Schroedinger Tests");
-  suite->addTest(FieldTest::suite());
   CppUnit::TextUi::TestRunner runner;
-  runner.addTest(suite);
+  runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
   runner.run();
   return 0;
 }
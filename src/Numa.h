@@ -0,0 +1,127 @@
+#ifndef SCHROEDINGER_NUMA_H
+#define SCHROEDINGER_NUMA_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// The page placement key for pages that have not been touched yet.
+const int UNPLACED_PAGE = -1;
+
+/// Parse a Linux CPU or node list like "0-3,8,10-11".
+inline std::vector<int> parseIdList(const std::string &list) {
+  std::vector<int> ids;
+  std::stringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+    const size_t dash = range.find('-');
+    const int first = std::stoi(range.substr(0, dash));
+    const int last =
+        dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int id = first; id <= last; id++) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+/// The CPUs the calling thread is allowed to run on.
+inline std::vector<int> allowedCpus() {
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+/// The CPUs of each online NUMA node. Empty if the topology is unknown.
+inline std::vector<std::vector<int>> nodeCpus() {
+  std::vector<std::vector<int>> result;
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string nodes;
+  if (!std::getline(online, nodes)) {
+    return result;
+  }
+  for (int node : parseIdList(nodes)) {
+    std::ifstream cpuList("/sys/devices/system/node/node" +
+                          std::to_string(node) + "/cpulist");
+    std::string cpus;
+    std::getline(cpuList, cpus);
+    result.push_back(parseIdList(cpus));
+  }
+  return result;
+}
+
+/// Add the number of pages of [begin, begin + size) that reside on each NUMA
+/// node to counts. Pages that have not been touched are counted as
+/// UNPLACED_PAGE. Does nothing where the placement cannot be queried.
+inline void countPageNodes(const void *begin, size_t size,
+                           std::map<int, long> &counts) {
+#if defined(__linux__) && defined(SYS_move_pages)
+  const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+  const uintptr_t first = reinterpret_cast<uintptr_t>(begin) & ~(pageSize - 1);
+  const uintptr_t end = reinterpret_cast<uintptr_t>(begin) + size;
+  const size_t chunk = 1024;
+  std::vector<void *> pages;
+  std::vector<int> status(chunk);
+  for (uintptr_t page = first; page < end;) {
+    pages.clear();
+    for (; page < end && pages.size() < chunk; page += pageSize) {
+      pages.push_back(reinterpret_cast<void *>(page));
+    }
+    // With no target nodes, move_pages only reports the current placement.
+    if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr,
+                status.data(), 0) != 0) {
+      return;
+    }
+    for (size_t i = 0; i < pages.size(); i++) {
+      counts[status[i] < 0 ? UNPLACED_PAGE : status[i]]++;
+    }
+  }
+#endif
+}
+
+/// Describe the page counts from countPageNodes as a single line.
+inline std::string placementStats(const std::map<int, long> &counts) {
+  long total = 0;
+  for (const auto &count : counts) {
+    total += count.second;
+  }
+  if (total == 0) {
+    return "Page placement: unknown";
+  }
+  std::stringstream stats;
+  stats << "Page placement:";
+  for (const auto &count : counts) {
+    if (count.first == UNPLACED_PAGE) {
+      stats << " unplaced ";
+    } else {
+      stats << " node " << count.first << " ";
+    }
+    stats << (100 * count.second / total) << "%";
+  }
+  stats << " of " << total << " pages";
+  return stats.str();
+}
+
+#endif // SCHROEDINGER_NUMA_H
@@ -0,0 +1,171 @@
+#include <exception>
+#include <vector>
+
+#include "Schroedinger.h"
+#include "Wave.h"
+
+struct schr_wave {
+  explicit schr_wave(const WaveConfig &config) : wave(config) {}
+  Wave wave;
+};
+
+template <typename T>
+static schr_view toView(const FieldView<T> &view, int components) {
+  return {reinterpret_cast<const double *>(view.origin), view.width,
+          view.height, view.stride, view.border, components};
+}
+
+static schr_ground_state_result toResult(const GroundStateResult &result) {
+  return {result.converged, result.iterations, result.energy,
+          result.energyChange, result.residual};
+}
+
+int schr_api_version() { return SCHR_API_VERSION; }
+
+void schr_config_init(schr_config *config) {
+  const WaveConfig defaults;
+  config->width = defaults.width;
+  config->height = defaults.height;
+  config->order = defaults.order;
+  config->threads = defaults.threads;
+  config->pinning = SCHR_NO_PINNING;
+}
+
+schr_wave *schr_create(const schr_config *config) {
+  WaveConfig waveConfig;
+  waveConfig.width = config->width;
+  waveConfig.height = config->height;
+  waveConfig.order = config->order;
+  waveConfig.threads = config->threads;
+  switch (config->pinning) {
+  case SCHR_NO_PINNING:
+    waveConfig.pinning = NO_PINNING;
+    break;
+  case SCHR_PIN_CPUS:
+    waveConfig.pinning = PIN_CPUS;
+    break;
+  case SCHR_PIN_NODES:
+    waveConfig.pinning = PIN_NODES;
+    break;
+  default:
+    return nullptr;
+  }
+  const int border = waveConfig.order / 2;
+  if ((waveConfig.order != 2 && waveConfig.order != 4 &&
+       waveConfig.order != 6) ||
+      waveConfig.width < border || waveConfig.height < border ||
+      !Field<dcomp>::fits(waveConfig.width, waveConfig.height, border) ||
+      waveConfig.threads < 0) {
+    return nullptr;
+  }
+  try {
+    return new schr_wave(waveConfig);
+  } catch (const std::exception &) {
+    return nullptr;
+  }
+}
+
+void schr_destroy(schr_wave *wave) { delete wave; }
+
+void schr_evolve(schr_wave *wave, int steps) {
+  for (int i = 0; i < steps; i++) {
+    wave->wave.evolve();
+  }
+}
+
+void schr_normalize(schr_wave *wave) { wave->wave.normalize(); }
+
+void schr_normalize_unlimited(schr_wave *wave) {
+  wave->wave.normalize(false);
+}
+
+void schr_add_bumps(schr_wave *wave, const schr_bump *bumps, size_t count) {
+  std::vector<Bump> waveBumps(count);
+  for (size_t i = 0; i < count; i++) {
+    waveBumps[i] = {bumps[i].x, bumps[i].y, dcomp(bumps[i].re, bumps[i].im),
+                    bumps[i].size};
+  }
+  wave->wave.addBumps(waveBumps.data(), count);
+}
+
+void schr_add_potential_bumps(schr_wave *wave,
+                              const schr_potential_bump *bumps, size_t count) {
+  std::vector<PotentialBump> waveBumps(count);
+  for (size_t i = 0; i < count; i++) {
+    waveBumps[i] = {bumps[i].x, bumps[i].y, bumps[i].c, bumps[i].size};
+  }
+  wave->wave.addPotentialBumps(waveBumps.data(), count);
+}
+
+void schr_ground_state_config_init(schr_ground_state_config *config) {
+  const GroundStateConfig defaults;
+  config->max_iterations = defaults.maxIterations;
+  config->energy_tolerance = defaults.energyTolerance;
+  config->residual_tolerance = defaults.residualTolerance;
+  config->stall_iterations = defaults.stallIterations;
+  config->conjugate_gradient = defaults.conjugateGradient;
+  config->step_factor = defaults.stepFactor;
+  config->poisson_tolerance = defaults.poissonTolerance;
+  config->progress = nullptr;
+  config->progress_data = nullptr;
+}
+
+schr_ground_state_result
+schr_find_ground_state(schr_wave *wave,
+                       const schr_ground_state_config *config) {
+  GroundStateConfig waveConfig;
+  waveConfig.maxIterations = config->max_iterations;
+  waveConfig.energyTolerance = config->energy_tolerance;
+  waveConfig.residualTolerance = config->residual_tolerance;
+  waveConfig.stallIterations = config->stall_iterations;
+  waveConfig.conjugateGradient = config->conjugate_gradient != 0;
+  waveConfig.stepFactor = config->step_factor;
+  waveConfig.poissonTolerance = config->poisson_tolerance;
+  if (config->progress != nullptr) {
+    waveConfig.progress = [config](const GroundStateResult &result) {
+      const schr_ground_state_result cResult = toResult(result);
+      return config->progress(&cResult, config->progress_data) != 0;
+    };
+  }
+  return toResult(wave->wave.findGroundState(waveConfig));
+}
+
+int schr_save_psi(const schr_wave *wave, const char *path) {
+  return wave->wave.savePsi(path);
+}
+
+int schr_load_psi(schr_wave *wave, const char *path) {
+  return wave->wave.loadPsi(path);
+}
+
+schr_view schr_psi(const schr_wave *wave) {
+  return toView(wave->wave.psi(), 2);
+}
+
+schr_view schr_potential(const schr_wave *wave) {
+  return toView(wave->wave.potential(), 1);
+}
+
+schr_view schr_dyn_potential(const schr_wave *wave) {
+  return toView(wave->wave.dynPotential(), 1);
+}
+
+schr_observables schr_get_observables(const schr_wave *wave) {
+  const Observables &o = wave->wave.observables();
+  schr_observables result;
+  result.step = o.step;
+  result.time = o.time;
+  result.norm = o.norm;
+  result.kinetic = o.kinetic;
+  result.potential = o.potential;
+  result.self_energy = o.selfEnergy;
+  result.energy = o.energy;
+  result.center_x = o.centerX;
+  result.center_y = o.centerY;
+  result.spread_x = o.spreadX;
+  result.spread_y = o.spreadY;
+  result.momentum_x = o.momentumX;
+  result.momentum_y = o.momentumY;
+  result.momentum_spread = o.momentumSpread;
+  return result;
+}
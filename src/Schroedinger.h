@@ -0,0 +1,186 @@
+#ifndef SCHROEDINGER_SCHROEDINGER_H
+#define SCHROEDINGER_SCHROEDINGER_H
+
+/* A C interface to the simulation, for use from other languages. It wraps the
+ * Wave class; see Wave.h for the details.
+ *
+ * Example:
+ * schr_config config;
+ * schr_config_init(&config);
+ * config.width = 512;
+ * schr_wave *wave = schr_create(&config);
+ * schr_bump bump = {100, 50, 1.0, 0.0, 6};
+ * schr_add_bumps(wave, &bump, 1);
+ * schr_normalize(wave);
+ * schr_evolve(wave, 5);
+ * schr_view psi = schr_psi(wave);
+ * double re = psi.data[2 * (x + y * psi.stride)];
+ * schr_destroy(wave);
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The version of this interface. It changes whenever the interface does. */
+#define SCHR_API_VERSION 4
+
+/* A simulation. */
+typedef struct schr_wave schr_wave;
+
+/* Where to run the solver's threads. */
+typedef enum {
+  SCHR_NO_PINNING = 0,
+  SCHR_PIN_CPUS = 1,
+  SCHR_PIN_NODES = 2
+} schr_pinning;
+
+/* The parameters of a simulation. */
+typedef struct {
+  int width;            /* The number of cells in a row. */
+  int height;           /* The number of cells in a column. */
+  int order;            /* The order of accuracy of the stencils: 2, 4 or 6. */
+  int threads;          /* The number of threads, or 0 for one per CPU. */
+  schr_pinning pinning; /* Where to run the threads. */
+} schr_config;
+
+/* A bump function to add to the wave: re + i * im at the center (x, y),
+ * decreasing linearly to 0 at distance size. The coordinates wrap around the
+ * grid, so the center may lie outside of it. */
+typedef struct {
+  int x;
+  int y;
+  double re;
+  double im;
+  int size;
+} schr_bump;
+
+/* A bump function to add to the static potential. */
+typedef struct {
+  int x;
+  int y;
+  double c;
+  int size;
+} schr_potential_bump;
+
+/* A read-only view of a field. Each cell consists of the given number of
+ * components: 2 (real and imaginary part) for the wave function, 1 for the
+ * potentials. The first component of cell (x, y) is
+ * data[components * (x + y * stride)], for -border <= x < width + border and
+ * -border <= y < height + border. */
+typedef struct {
+  const double *data;
+  int width;
+  int height;
+  int stride;
+  int border;
+  int components;
+} schr_view;
+
+/* Physical quantities of the wave, in SI units, at the beginning of the last
+ * time step. See Observables in Wave.h. */
+typedef struct {
+  long step;
+  double time;
+  double norm;
+  double kinetic;
+  double potential;
+  double self_energy;
+  double energy;
+  double center_x;
+  double center_y;
+  double spread_x;
+  double spread_y;
+  double momentum_x;
+  double momentum_y;
+  double momentum_spread;
+} schr_observables;
+
+/* The outcome of the ground state search. See GroundStateResult in Wave.h. */
+typedef struct {
+  int converged;
+  int iterations;
+  double energy;
+  double energy_change;
+  double residual;
+} schr_ground_state_result;
+
+/* The parameters of the ground state search. See GroundStateConfig in Wave.h.
+ */
+typedef struct {
+  int max_iterations;
+  double energy_tolerance;
+  double residual_tolerance;
+  int stall_iterations;
+  int conjugate_gradient; /* Nonzero to accelerate the iteration. */
+  double step_factor;
+  double poisson_tolerance;
+  /* If not NULL, called before each iteration with the current state and
+   * progress_data. Returning 0 stops the search. */
+  int (*progress)(const schr_ground_state_result *result, void *progress_data);
+  void *progress_data;
+} schr_ground_state_config;
+
+/* The value of SCHR_API_VERSION the library was built with. */
+int schr_api_version(void);
+
+/* Set the parameters to their defaults. */
+void schr_config_init(schr_config *config);
+
+/* Create a simulation. Returns NULL if the parameters are invalid, the grid is
+ * too large to be indexed with ints, or the memory could not be allocated. */
+schr_wave *schr_create(const schr_config *config);
+
+/* Destroy the simulation. Invalidates its views. Does nothing for NULL. */
+void schr_destroy(schr_wave *wave);
+
+/* Compute the given number of time steps. */
+void schr_evolve(schr_wave *wave, int steps);
+
+/* Normalize the wave function, so that it has norm 1, after limiting the
+ * amplitude of each cell. */
+void schr_normalize(schr_wave *wave);
+
+/* Normalize the wave function without limiting its amplitude, e.g. after
+ * loading or computing a ground state. */
+void schr_normalize_unlimited(schr_wave *wave);
+
+/* Add the given bump functions to the wave. */
+void schr_add_bumps(schr_wave *wave, const schr_bump *bumps, size_t count);
+
+/* Add the given bump functions to the static potential. */
+void schr_add_potential_bumps(schr_wave *wave,
+                              const schr_potential_bump *bumps, size_t count);
+
+/* Set the ground state search parameters to their defaults. */
+void schr_ground_state_config_init(schr_ground_state_config *config);
+
+/* Replace the wave function with the ground state in the current potential. */
+schr_ground_state_result
+schr_find_ground_state(schr_wave *wave, const schr_ground_state_config *config);
+
+/* Write the wave function and the potentials to the given file, in the native
+ * byte order. See Wave::savePsi for the format. Returns nonzero on success. */
+int schr_save_psi(const schr_wave *wave, const char *path);
+
+/* Read the wave function and the potentials from a file written by
+ * schr_save_psi for a grid of the same size. Returns nonzero on success. */
+int schr_load_psi(schr_wave *wave, const char *path);
+
+/* Views of the wave function, the static and the gravitational potential. They
+ * remain valid until the simulation is destroyed, and their contents change
+ * with every call that modifies the simulation. */
+schr_view schr_psi(const schr_wave *wave);
+schr_view schr_potential(const schr_wave *wave);
+schr_view schr_dyn_potential(const schr_wave *wave);
+
+/* The physical quantities computed during the last time step. */
+schr_observables schr_get_observables(const schr_wave *wave);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCHROEDINGER_SCHROEDINGER_H */
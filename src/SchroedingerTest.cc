@@ -0,0 +1,146 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestFixture.h>
+
+#include "Schroedinger.h"
+
+class SchroedingerTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(SchroedingerTest);
+  CPPUNIT_TEST(testCreate);
+  CPPUNIT_TEST(testInvalidConfig);
+  CPPUNIT_TEST(testViews);
+  CPPUNIT_TEST(testAddBumps);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void testCreate();
+  void testInvalidConfig();
+  void testViews();
+  void testAddBumps();
+
+private:
+  const int width = 40;
+  const int height = 24;
+  // A valid configuration of a small, single-threaded simulation.
+  schr_config config();
+  // Whether schr_create() accepts the configuration. Destroys the simulation.
+  bool accepts(const schr_config &config);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SchroedingerTest);
+
+schr_config SchroedingerTest::config() {
+  schr_config config;
+  schr_config_init(&config);
+  config.width = width;
+  config.height = height;
+  config.threads = 1;
+  return config;
+}
+
+bool SchroedingerTest::accepts(const schr_config &config) {
+  schr_wave *wave = schr_create(&config);
+  schr_destroy(wave);
+  return wave != nullptr;
+}
+
+void SchroedingerTest::testCreate() {
+  CPPUNIT_ASSERT_EQUAL(SCHR_API_VERSION, schr_api_version());
+  schr_config defaults;
+  schr_config_init(&defaults);
+  CPPUNIT_ASSERT(defaults.width > 0);
+  CPPUNIT_ASSERT(defaults.height > 0);
+  CPPUNIT_ASSERT_EQUAL(2, defaults.order);
+  CPPUNIT_ASSERT(accepts(config()));
+  for (int order = 2; order <= 6; order += 2) {
+    schr_config c = config();
+    c.order = order;
+    c.threads = 0;
+    c.pinning = SCHR_PIN_CPUS;
+    CPPUNIT_ASSERT(accepts(c));
+  }
+  // Destroying NULL does nothing, like free().
+  schr_destroy(nullptr);
+}
+
+void SchroedingerTest::testInvalidConfig() {
+  schr_config c = config();
+  c.order = 3;
+  CPPUNIT_ASSERT(!accepts(c));
+  c = config();
+  c.width = 0;
+  CPPUNIT_ASSERT(!accepts(c));
+  c = config();
+  c.height = -5;
+  CPPUNIT_ASSERT(!accepts(c));
+  // The grid must be at least as large as the border.
+  c = config();
+  c.order = 6;
+  c.width = 2;
+  CPPUNIT_ASSERT(!accepts(c));
+  c = config();
+  c.threads = -1;
+  CPPUNIT_ASSERT(!accepts(c));
+  c = config();
+  c.pinning = static_cast<schr_pinning>(3);
+  CPPUNIT_ASSERT(!accepts(c));
+  // Too many cells to be indexed with ints.
+  c = config();
+  c.width = 65534;
+  c.height = 65535;
+  CPPUNIT_ASSERT(!accepts(c));
+}
+
+void SchroedingerTest::testViews() {
+  const schr_config c = config();
+  schr_wave *wave = schr_create(&c);
+  CPPUNIT_ASSERT(wave != nullptr);
+  const schr_view psi = schr_psi(wave);
+  const schr_view potential = schr_potential(wave);
+  const schr_view dynPotential = schr_dyn_potential(wave);
+  CPPUNIT_ASSERT_EQUAL(2, psi.components);
+  CPPUNIT_ASSERT_EQUAL(1, potential.components);
+  CPPUNIT_ASSERT_EQUAL(1, dynPotential.components);
+  const schr_view views[] = {psi, potential, dynPotential};
+  for (const schr_view &view : views) {
+    CPPUNIT_ASSERT(view.data != nullptr);
+    CPPUNIT_ASSERT_EQUAL(width, view.width);
+    CPPUNIT_ASSERT_EQUAL(height, view.height);
+    CPPUNIT_ASSERT_EQUAL(1, view.border);
+    CPPUNIT_ASSERT_EQUAL(width + 2, view.stride);
+  }
+  // The views are not copies: they show the current state.
+  const double *center = psi.data + 2 * (width / 2 + height / 2 * psi.stride);
+  const double before = center[0];
+  schr_bump bump = {width / 2, height / 2, 1.0, 0.0, 4};
+  schr_add_bumps(wave, &bump, 1);
+  CPPUNIT_ASSERT_EQUAL(psi.data, schr_psi(wave).data);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(before + 1.0, center[0], 1e-12);
+  schr_destroy(wave);
+}
+
+void SchroedingerTest::testAddBumps() {
+  const schr_config c = config();
+  schr_wave *wave = schr_create(&c);
+  const schr_view psi = schr_psi(wave);
+  const schr_view potential = schr_potential(wave);
+  // A bump centered outside of the grid wraps around, and the border is
+  // filled afterwards.
+  schr_bump bump = {-1, 0, 0.0, 2.0, 3};
+  schr_add_bumps(wave, &bump, 1);
+  const double *last = psi.data + 2 * (width - 1);
+  CPPUNIT_ASSERT(last[1] > 1.0);
+  CPPUNIT_ASSERT_EQUAL(last[1], psi.data[2 * (-1) + 1]);
+  // A huge bump is clamped instead of overflowing.
+  schr_bump huge = {0, 0, 1.0, 0.0, 2000000000};
+  schr_add_bumps(wave, &huge, 1);
+  const schr_potential_bump potentialBump = {width - 1, height - 1, 1.0, 3};
+  schr_add_potential_bumps(wave, &potentialBump, 1);
+  CPPUNIT_ASSERT(potential.data[width - 1 + (height - 1) * potential.stride] >
+                 0.0);
+  CPPUNIT_ASSERT_EQUAL(
+      potential.data[width - 1 + (height - 1) * potential.stride],
+      potential.data[-1 + -1 * potential.stride]);
+  schr_destroy(wave);
+}
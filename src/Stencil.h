@@ -0,0 +1,148 @@
+#ifndef SCHROEDINGER_STENCIL_H
+#define SCHROEDINGER_STENCIL_H
+
+#include "Field.h"
+
+/// Finite difference stencils of the given order of accuracy, for the Laplace
+/// operator, the gradient and the Poisson equation. A Field needs a border of
+/// order / 2.
+///
+/// Order 2 uses the 9-point stencil for the Laplacian and the 5-point stencil
+/// for the Poisson equation. Orders 4 and 6 add the one-dimensional central
+/// differences along both axes:
+///   order 4: -1/12  4/3  -5/2  4/3  -1/12
+///   order 6: 1/90  -3/20  3/2  -49/18  3/2  -3/20  1/90
+/// The gradient uses the central differences of the first derivative.
+template <int order> struct Stencil {
+  static_assert(order == 2 || order == 4 || order == 6,
+                "Only orders 2, 4 and 6 are supported.");
+  /// The width of the border the stencil needs.
+  static const int border = order / 2;
+  /// The Laplacian of f at (x, y), times the squared cell size.
+  template <typename T> static T laplace(const Field<T> &f, int x, int y);
+  /// The partial derivatives of f at (x, y), times the cell size.
+  template <typename T> static T gradientX(const Field<T> &f, int x, int y);
+  template <typename T> static T gradientY(const Field<T> &f, int x, int y);
+  /// The largest absolute eigenvalue of laplace() on a toroidal grid, e.g. of
+  /// the checkerboard pattern.
+  static double spectralRadius();
+  /// The Laplacian of f at (x, y) that the Poisson equation uses, times the
+  /// squared cell size: the 5-point stencil for order 2, laplace() otherwise.
+  template <typename T> static T poisson(const Field<T> &f, int x, int y);
+  /// One damped Jacobi iteration for the Poisson equation poisson(v) = rhs at
+  /// (x, y), where rhsdrdr is rhs times the squared cell size.
+  static double jacobi(const Field<double> &v, int x, int y, double rhsdrdr);
+
+private:
+  /// The coefficient of the center (d = 0), or of the cells at distance d.
+  static double coeff(int d);
+  /// The coefficient of the cell at distance d in the first derivative.
+  static double gradientCoeff(int d);
+  /// The damping factor of the Jacobi iteration. Unlike the 5-point stencil,
+  /// the wide stencils are not diagonally dominant, and the undamped iteration
+  /// would amplify the highest frequencies.
+  static double jacobiWeight();
+};
+
+template <> inline double Stencil<2>::coeff(int d) {
+  static const double coeffs[] = {-2.0, 1.0};
+  return coeffs[d];
+}
+
+template <> inline double Stencil<4>::coeff(int d) {
+  static const double coeffs[] = {-5.0 / 2, 4.0 / 3, -1.0 / 12};
+  return coeffs[d];
+}
+
+template <> inline double Stencil<6>::coeff(int d) {
+  static const double coeffs[] = {-49.0 / 18, 3.0 / 2, -3.0 / 20, 1.0 / 90};
+  return coeffs[d];
+}
+
+template <> inline double Stencil<2>::gradientCoeff(int d) {
+  static const double coeffs[] = {0.0, 1.0 / 2};
+  return coeffs[d];
+}
+
+template <> inline double Stencil<4>::gradientCoeff(int d) {
+  static const double coeffs[] = {0.0, 2.0 / 3, -1.0 / 12};
+  return coeffs[d];
+}
+
+template <> inline double Stencil<6>::gradientCoeff(int d) {
+  static const double coeffs[] = {0.0, 3.0 / 4, -3.0 / 20, 1.0 / 60};
+  return coeffs[d];
+}
+
+template <> inline double Stencil<2>::spectralRadius() { return 4.0; }
+template <> inline double Stencil<4>::spectralRadius() { return 32.0 / 3; }
+template <> inline double Stencil<6>::spectralRadius() { return 544.0 / 45; }
+
+template <> inline double Stencil<2>::jacobiWeight() { return 1.0; }
+template <> inline double Stencil<4>::jacobiWeight() { return 0.8; }
+template <> inline double Stencil<6>::jacobiWeight() { return 0.75; }
+
+template <int order>
+template <typename T>
+inline T Stencil<order>::laplace(const Field<T> &f, int x, int y) {
+  return poisson(f, x, y);
+}
+
+// The average of the 5-point stencil and the diagonal one, whose cells are
+// twice as far away, squared.
+template <>
+template <typename T>
+inline T Stencil<2>::laplace(const Field<T> &f, int x, int y) {
+  T w4 = 4.0 * f.get(x, y);
+  T s = f.get(x + 1, y) + f.get(x - 1, y) + f.get(x, y - 1) + f.get(x, y + 1) -
+        w4;
+  T sdiag = f.get(x + 1, y + 1) + f.get(x + 1, y - 1) + f.get(x - 1, y + 1) +
+            f.get(x - 1, y - 1) - w4;
+  return 0.5 * (s + 0.5 * sdiag);
+}
+
+template <int order>
+template <typename T>
+inline T Stencil<order>::gradientX(const Field<T> &f, int x, int y) {
+  T result = 0;
+  for (int d = 1; d <= border; d++) {
+    result += gradientCoeff(d) * (f.get(x + d, y) - f.get(x - d, y));
+  }
+  return result;
+}
+
+template <int order>
+template <typename T>
+inline T Stencil<order>::gradientY(const Field<T> &f, int x, int y) {
+  T result = 0;
+  for (int d = 1; d <= border; d++) {
+    result += gradientCoeff(d) * (f.get(x, y + d) - f.get(x, y - d));
+  }
+  return result;
+}
+
+template <int order>
+template <typename T>
+inline T Stencil<order>::poisson(const Field<T> &f, int x, int y) {
+  T result = 2.0 * coeff(0) * f.get(x, y);
+  for (int d = 1; d <= border; d++) {
+    result += coeff(d) * (f.get(x + d, y) + f.get(x - d, y) + f.get(x, y + d) +
+                          f.get(x, y - d));
+  }
+  return result;
+}
+
+template <int order>
+inline double Stencil<order>::jacobi(const Field<double> &v, int x, int y,
+                                     double rhsdrdr) {
+  double neighbors = 0;
+  for (int d = 1; d <= border; d++) {
+    neighbors += coeff(d) * (v.get(x + d, y) + v.get(x - d, y) +
+                             v.get(x, y + d) + v.get(x, y - d));
+  }
+  const double oldV = v.get(x, y);
+  const double newV = (rhsdrdr - neighbors) / (2.0 * coeff(0));
+  return oldV + jacobiWeight() * (newV - oldV);
+}
+
+#endif // SCHROEDINGER_STENCIL_H
@@ -0,0 +1,137 @@
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Stencil.h"
+#include "Wave.h"
+
+using namespace std;
+
+// The number of periods of the test wave along the x and y axis of the unit
+// square.
+const int PERIODS_X = 4;
+const int PERIODS_Y = 3;
+
+// The grid sizes to compare.
+const vector<int> SIZES = {16,  24,  32,  40,  48,  56,  64,  80,  96,
+                           112, 128, 160, 192, 224, 256, 320, 384, 512};
+
+// The 9-point stencil as it was before the stencils of higher order were added,
+// with the diagonal neighbors weighted by 1 / sqrt(2) instead of 1 / 2. It
+// overestimates the Laplacian by a constant factor, so its error does not
+// decrease with the grid size.
+struct SqrtTwoStencil {
+  template <typename T> static T laplace(const Field<T> &f, int x, int y) {
+    T w4 = 4.0 * f.get(x, y);
+    T s = f.get(x + 1, y) + f.get(x - 1, y) + f.get(x, y - 1) +
+          f.get(x, y + 1) - w4;
+    T sdiag = f.get(x + 1, y + 1) + f.get(x + 1, y - 1) +
+              f.get(x - 1, y + 1) + f.get(x - 1, y - 1) - w4;
+    return 0.5 * (s + sdiag / sqrt(2.0));
+  }
+};
+
+// The maximum relative error of the Laplacian S::laplace of a plane wave on an
+// n * n discretization of the unit square, with the given border.
+template <typename S> double laplaceError(int n, int border) {
+  Field<dcomp> f(n, n, border, WRAP);
+  const double kx = 2.0 * M_PI * PERIODS_X;
+  const double ky = 2.0 * M_PI * PERIODS_Y;
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < n; x++) {
+      f.set(x, y, polar(1.0, (kx * x + ky * y) / n));
+    }
+  }
+  f.fillBorder();
+  double maxErr = 0;
+  for (int y = 0; y < n; y++) {
+    for (int x = 0; x < n; x++) {
+      const dcomp exact = -(kx * kx + ky * ky) * f.get(x, y);
+      const dcomp approx = S::laplace(f, x, y) * double(n * n);
+      maxErr = max(maxErr, abs(approx - exact) / abs(exact));
+    }
+  }
+  return maxErr;
+}
+
+double laplaceError(int order, int n) {
+  switch (order) {
+  case 4:
+    return laplaceError<Stencil<4>>(n, 2);
+  case 6:
+    return laplaceError<Stencil<6>>(n, 3);
+  default:
+    return laplaceError<Stencil<2>>(n, 1);
+  }
+}
+
+double originalError(int n) { return laplaceError<SqrtTwoStencil>(n, 1); }
+
+// The number of threads of the timed runs. It is fixed, so that the times of
+// different grid sizes are comparable.
+const int THREADS = 1;
+
+// The average wall-clock time in ms of a time step on an n * n grid.
+double stepTime(int order, int n, int steps) {
+  Wave wave(n, n, order, THREADS);
+  wave.addBump(n / 2, n / 2, 1.0, n / 8);
+  wave.normalize();
+  wave.evolve();
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < steps; i++) {
+    wave.normalize();
+    wave.evolve();
+  }
+  chrono::duration<double, milli> time = chrono::steady_clock::now() - start;
+  return time.count() / steps;
+}
+
+/// Compare the accuracy of the Laplace stencils of order 2, 4 and 6, and the
+/// time per step on the coarsest grids that are as accurate as the order 2
+/// stencil on the reference grid. The error of the original 9-point stencil is
+/// shown for reference; it needs the same time per step as order 2.
+///
+/// Usage: stencilbench [reference size] [steps]
+int main(int argc, char *argv[]) {
+  const int refSize = (argc > 1) ? stoi(argv[1]) : 256;
+  const int steps = (argc > 2) ? stoi(argv[2]) : 10;
+  const vector<int> orders = {2, 4, 6};
+
+  cout << "Relative error of the Laplacian of a plane wave:" << endl;
+  cout << setw(6) << "size" << setw(12) << "original";
+  for (int order : orders) {
+    cout << setw(12) << ("order " + to_string(order));
+  }
+  cout << endl;
+  for (int n : SIZES) {
+    cout << setw(6) << n << setw(12) << setprecision(3) << originalError(n);
+    for (int order : orders) {
+      cout << setw(12) << setprecision(3) << laplaceError(order, n);
+    }
+    cout << endl;
+  }
+
+  const double refErr = laplaceError(2, refSize);
+  cout << endl
+       << "Grid reaching the error " << refErr << " of order 2 at " << refSize
+       << "x" << refSize << ", threads: " << THREADS << endl;
+  const double refTime = stepTime(2, refSize, steps);
+  for (int order : orders) {
+    int n = refSize;
+    for (int size : SIZES) {
+      if (size < n && laplaceError(order, size) <= refErr) {
+        n = size;
+        break;
+      }
+    }
+    const double time = order == 2 ? refTime : stepTime(order, n, steps);
+    cout << "order " << order << ": " << n << "x" << n << ", "
+         << setprecision(4) << time << " ms per step, speedup "
+         << setprecision(3) << refTime / time << endl;
+  }
+  return 0;
+}
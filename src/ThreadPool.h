@@ -0,0 +1,185 @@
+#ifndef SCHROEDINGER_THREADPOOL_H
+#define SCHROEDINGER_THREADPOOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+#include "Numa.h"
+
+/// Where to run the workers of a ThreadPool.
+enum Pinning {
+  NO_PINNING, ///< Let the operating system schedule the workers.
+  PIN_CPUS,   ///< Pin each worker to its own CPU.
+  PIN_NODES,  ///< Pin each worker to the CPUs of a NUMA node. Neighboring bands
+              ///< share a node.
+};
+
+/// A fixed set of worker threads for loops over the rows of a grid.
+///
+/// A range of rows is split into size() contiguous bands, and the i-th band is
+/// always handled by the i-th worker, so that repeated sweeps over the same
+/// rows see the same partitioning.
+///
+/// Example:
+/// ThreadPool pool(4);
+/// pool.forBands(0, height, [&](int band, int first, int last) {
+///   for (int y = first; y < last; y++) { ... }
+/// });
+class ThreadPool {
+public:
+  /// Create a pool with the given number of workers. If threads is 0, use one
+  /// worker per hardware thread. Pinning is ignored where it is not supported,
+  /// and if there is only one worker, which then is the calling thread.
+  explicit ThreadPool(int threads = 0, Pinning pinning = NO_PINNING);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  /// The number of bands a range is split into.
+  int size() const;
+  /// The first index of the given band of the range [begin, end).
+  int bandBegin(int band, int begin, int end) const;
+  /// Call f(band, first, last) for each band [first, last) of [begin, end) in
+  /// parallel, and wait until all calls have returned.
+  template <typename F> void forBands(int begin, int end, F f);
+
+private:
+  std::vector<std::vector<int>> workerCpus(Pinning pinning) const;
+  void work(int band, std::vector<int> cpus);
+  void run(const std::function<void(int)> &job);
+  int size_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const std::function<void(int)> *job_ = nullptr;
+  unsigned long generation_ = 0;
+  int pending_ = 0;
+  bool stopping_ = false;
+};
+
+inline ThreadPool::ThreadPool(int threads, Pinning pinning)
+    : size_(threads) {
+  if (size_ <= 0) {
+    size_ = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // With a single band, run jobs on the calling thread.
+  if (size_ > 1) {
+    const std::vector<std::vector<int>> cpus = workerCpus(pinning);
+    threads_.reserve(size_);
+    for (int band = 0; band < size_; band++) {
+      threads_.emplace_back(&ThreadPool::work, this, band, cpus[band]);
+    }
+  }
+}
+
+// Determine the CPUs each worker may run on. An empty list means any CPU.
+inline std::vector<std::vector<int>>
+ThreadPool::workerCpus(Pinning pinning) const {
+  std::vector<std::vector<int>> result(size_);
+  const std::vector<int> allowed = allowedCpus();
+  if (allowed.empty()) {
+    return result;
+  }
+  switch (pinning) {
+  case NO_PINNING:
+    break;
+  case PIN_CPUS:
+    for (int band = 0; band < size_; band++) {
+      result[band].push_back(allowed[band % allowed.size()]);
+    }
+    break;
+  case PIN_NODES: {
+    const std::vector<std::vector<int>> nodes = nodeCpus();
+    for (int band = 0; band < size_ && !nodes.empty(); band++) {
+      for (int cpu : nodes[band * nodes.size() / size_]) {
+        if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end()) {
+          result[band].push_back(cpu);
+        }
+      }
+    }
+    break;
+  }
+  }
+  return result;
+}
+
+inline ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+inline int ThreadPool::size() const { return size_; }
+
+inline int ThreadPool::bandBegin(int band, int begin, int end) const {
+  return begin + static_cast<int>(static_cast<long long>(end - begin) * band /
+                                  size_);
+}
+
+template <typename F> void ThreadPool::forBands(int begin, int end, F f) {
+  run([&](int band) {
+    f(band, bandBegin(band, begin, end), bandBegin(band + 1, begin, end));
+  });
+}
+
+// Pin the worker to the given CPUs, if any. Then wait for a new job and run it
+// on the given band, until the pool is stopped.
+inline void ThreadPool::work(int band, std::vector<int> cpus) {
+#ifdef __linux__
+  if (!cpus.empty()) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+      CPU_SET(cpu, &set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#endif
+  unsigned long seen = 0;
+  while (true) {
+    const std::function<void(int)> *job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+      job = job_;
+    }
+    (*job)(band);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+// Run the job on every band and wait until all of them are finished.
+inline void ThreadPool::run(const std::function<void(int)> &job) {
+  if (threads_.empty()) {
+    job(0);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_ = &job;
+  pending_ = size_;
+  generation_++;
+  start_.notify_all();
+  done_.wait(lock, [&] { return pending_ == 0; });
+}
+
+#endif // SCHROEDINGER_THREADPOOL_H
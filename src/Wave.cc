@@ -1,38 +1,89 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <map>
 #include <math.h>
 #include <vector>
 
+#include "CompensatedSum.h"
+#include "Stencil.h"
 #include "Wave.h"
 
 using std::vector;
 
 const dcomp I = dcomp(0.0, 1.0);
 
-Wave::Wave(int width, int height) : width_(width), height_(height) {
+// Call f(band, first, last, sums) for each band of rows, where sums points to n
+// partial sums, initially 0, that f adds to. Returns the sums over all bands,
+// added up in band order so that the result does not depend on the scheduling.
+template <int n, typename F>
+static std::array<double, n> reduceBands(ThreadPool &pool, int height, F f) {
+  vector<std::array<double, n>> bandSums(pool.size());
+  pool.forBands(0, height, [&](int band, int first, int last) {
+    std::array<double, n> sums;
+    sums.fill(0);
+    f(band, first, last, sums.data());
+    bandSums[band] = sums;
+  });
+  std::array<CompensatedSum, n> sums;
+  for (const std::array<double, n> &partialSums : bandSums) {
+    for (int i = 0; i < n; i++) {
+      sums[i].add(partialSums[i]);
+    }
+  }
+  std::array<double, n> result;
+  for (int i = 0; i < n; i++) {
+    result[i] = sums[i].value();
+  }
+  return result;
+}
+
+// The mean of the cells of the field's main rectangle.
+static double mean(ThreadPool &pool, const Field<double> &field) {
+  const double sum = reduceBands<1>(
+      pool, field.height, [&](int, int first, int last, double *sums) {
+        for (int y = first; y < last; y++) {
+          for (int x = 0; x < field.width; x++) {
+            sums[0] += field.get(x, y);
+          }
+        }
+      })[0];
+  return sum / (static_cast<double>(field.width) * field.height);
+}
+
+Wave::Wave(int width, int height, int order, int threads, Pinning pinning)
+    : width_(width), height_(height), order_(order), pool_(threads, pinning) {
+  assert(order_ == 2 || order_ == 4 || order_ == 6);
   const int tmpPageNum = 4;
   // Reserve, as reallocation calls the Field destructor.
   // TODO: Proper move semantics for Field.
   tmpPsi_.reserve(tmpPageNum);
   for (int i = 0; i < tmpPageNum; i++) {
-    tmpPsi_.emplace_back(width_, height_, 1, boundary_);
+    tmpPsi_.emplace_back(width_, height_, border_, boundary_, &pool_);
   }
-  for (int x = 0; x < width_; x++) {
-    for (int y = 0; y < height_; y++) {
-      psi_.set(x, y, std::polar(1.0, 2.0 * M_PI * x / width_));
+  pool_.forBands(0, height_, [&](int, int first, int last) {
+    for (int y = first; y < last; y++) {
+      for (int x = 0; x < width_; x++) {
+        psi_.set(x, y, std::polar(1.0, 2.0 * M_PI * x / width_));
+      }
     }
-  }
+  });
   psi_.fillBorder();
   potential_.fillBorder();
+  for (int x = 0; x < width_; x++) {
+    cosX_.push_back(cos(2.0 * M_PI * x / width_));
+    sinX_.push_back(sin(2.0 * M_PI * x / width_));
+  }
+  for (int y = 0; y < height_; y++) {
+    cosY_.push_back(cos(2.0 * M_PI * y / height_));
+    sinY_.push_back(sin(2.0 * M_PI * y / height_));
+  }
 }
 
-inline dcomp Wave::laplace(const Field<dcomp> &f, int x, int y) const {
-  const static double qsqrt2 = 1.0 / sqrt(2.0);
-  dcomp w4 = 4.0 * f.get(x, y);
-  dcomp s = f.get(x + 1, y) + f.get(x - 1, y) + f.get(x, y - 1) +
-            f.get(x, y + 1) - w4;
-  dcomp sdiag = f.get(x + 1, y + 1) + f.get(x + 1, y - 1) +
-                f.get(x - 1, y + 1) + f.get(x - 1, y - 1) - w4;
-  return 0.5 * (s + sdiag * qsqrt2) * qdrdr_;
-}
+Wave::Wave(const WaveConfig &config)
+    : Wave(config.width, config.height, config.order, config.threads,
+           config.pinning) {}
 
 inline dcomp Wave::calcDPsiXY(dcomp laplaceXY, dcomp psiXY, dcomp VXY) const {
   // The factor of the Laplacian.
@@ -43,51 +94,301 @@ inline dcomp Wave::calcDPsiXY(dcomp laplaceXY, dcomp psiXY, dcomp VXY) const {
 }
 
 void Wave::calcK(Field<dcomp> &newk, const Field<dcomp> &oldk, double factor) {
-  for (int x = 0; x < width_; x++) {
-    for (int y = 0; y < height_; y++) {
-      dcomp laplaceXY = laplace(psi_, x, y) + factor * laplace(oldk, x, y);
-      dcomp psiXY = psi_.get(x, y) + factor * oldk.get(x, y);
-      double VXY = potential_.get(x, y) + dynPotential_.get(x, y);
-      newk.set(x, y, calcDPsiXY(laplaceXY, psiXY, VXY));
+  switch (order_) {
+  case 2:
+    calcK<2>(newk, oldk, factor);
+    break;
+  case 4:
+    calcK<4>(newk, oldk, factor);
+    break;
+  case 6:
+    calcK<6>(newk, oldk, factor);
+    break;
+  }
+}
+
+template <int order>
+void Wave::calcK(Field<dcomp> &newk, const Field<dcomp> &oldk, double factor) {
+  typedef Stencil<order> S;
+  pool_.forBands(0, height_, [&](int, int first, int last) {
+    for (int y = first; y < last; y++) {
+      for (int x = 0; x < width_; x++) {
+        dcomp laplaceXY = (S::laplace(psi_, x, y) +
+                           factor * S::laplace(oldk, x, y)) *
+                          qdrdr_;
+        dcomp psiXY = psi_.get(x, y) + factor * oldk.get(x, y);
+        double VXY = potential_.get(x, y) + dynPotential_.get(x, y);
+        newk.set(x, y, calcDPsiXY(laplaceXY, psiXY, VXY));
+      }
     }
+  });
+  newk.fillBorder();
+}
+
+void Wave::calcFirstK(Field<dcomp> &newk) {
+  switch (order_) {
+  case 2:
+    calcFirstK<2>(newk);
+    break;
+  case 4:
+    calcFirstK<4>(newk);
+    break;
+  case 6:
+    calcFirstK<6>(newk);
+    break;
+  }
+}
+
+// The sums over all cells that the observables are computed from.
+struct ObservableSums {
+  CompensatedSum norm;
+  CompensatedSum kinetic;
+  CompensatedSum potential;
+  CompensatedSum selfEnergy;
+  CompensatedSum momentumX;
+  CompensatedSum momentumY;
+  CompensatedSum cosX;
+  CompensatedSum sinX;
+  CompensatedSum cosY;
+  CompensatedSum sinY;
+  void add(const ObservableSums &other) {
+    norm.add(other.norm);
+    kinetic.add(other.kinetic);
+    potential.add(other.potential);
+    selfEnergy.add(other.selfEnergy);
+    momentumX.add(other.momentumX);
+    momentumY.add(other.momentumY);
+    cosX.add(other.cosX);
+    sinX.add(other.sinX);
+    cosY.add(other.cosY);
+    sinY.add(other.sinY);
   }
+};
+
+// The circular mean and standard deviation of a position on a circle of the
+// given circumference, given the mean cosine and sine of its angle.
+static void circularStats(double meanCos, double meanSin, double circumference,
+                          double &center, double &spread) {
+  const double angle = atan2(meanSin, meanCos);
+  center = (angle < 0 ? angle + 2.0 * M_PI : angle) * circumference /
+           (2.0 * M_PI);
+  spread = sqrt(-2.0 * log(hypot(meanCos, meanSin))) * circumference /
+           (2.0 * M_PI);
+}
+
+// Compute the first Runge-Kutta stage, i.e. the derivative of psi_ itself, and
+// the observables from the values it uses. Each row is added up separately,
+// and the rows' sums are added with compensation.
+template <int order> void Wave::calcFirstK(Field<dcomp> &newk) {
+  typedef Stencil<order> S;
+  vector<ObservableSums> bandSums(pool_.size());
+  pool_.forBands(0, height_, [&](int band, int first, int last) {
+    ObservableSums &sums = bandSums[band];
+    for (int y = first; y < last; y++) {
+      double rowNorm = 0, kinetic = 0, potential = 0, selfEnergy = 0;
+      double momentumX = 0, momentumY = 0, cosX = 0, sinX = 0;
+      for (int x = 0; x < width_; x++) {
+        const dcomp psiXY = psi_.get(x, y);
+        const dcomp laplaceXY = S::laplace(psi_, x, y) * qdrdr_;
+        const double staticV = potential_.get(x, y);
+        const double dynV = dynPotential_.get(x, y);
+        newk.set(x, y, calcDPsiXY(laplaceXY, psiXY, staticV + dynV));
+        const double normXY = norm(psiXY);
+        rowNorm += normXY;
+        kinetic += (conj(psiXY) * laplaceXY).real();
+        potential += staticV * normXY;
+        selfEnergy += dynV * normXY;
+        momentumX += (conj(psiXY) * S::gradientX(psi_, x, y)).imag();
+        momentumY += (conj(psiXY) * S::gradientY(psi_, x, y)).imag();
+        cosX += cosX_[x] * normXY;
+        sinX += sinX_[x] * normXY;
+      }
+      sums.norm.add(rowNorm);
+      sums.kinetic.add(kinetic);
+      sums.potential.add(potential);
+      sums.selfEnergy.add(selfEnergy);
+      sums.momentumX.add(momentumX);
+      sums.momentumY.add(momentumY);
+      sums.cosX.add(cosX);
+      sums.sinX.add(sinX);
+      sums.cosY.add(cosY_[y] * rowNorm);
+      sums.sinY.add(sinY_[y] * rowNorm);
+    }
+  });
   newk.fillBorder();
+  ObservableSums sums;
+  for (const ObservableSums &bandSum : bandSums) {
+    sums.add(bandSum);
+  }
+  const double n = sums.norm.value();
+  if (n <= 0) {
+    return;
+  }
+  const double hbar = PLANCK_CONST / (2.0 * M_PI);
+  // The Hamiltonian of calcDPsiXY, times the wave function.
+  const double kineticFactor = -hbar * hbar / m_;
+  Observables &o = observables_;
+  o.step = step_;
+  o.time = step_ * dt_;
+  o.norm = n * dr_ * dr_;
+  o.kinetic = kineticFactor * sums.kinetic.value() / n;
+  o.potential = sums.potential.value() / n;
+  // The self-interaction is counted for each pair of cells, i.e. twice.
+  o.selfEnergy = 0.5 * sums.selfEnergy.value() / n;
+  o.energy = o.kinetic + o.potential + o.selfEnergy;
+  o.momentumX = hbar * sums.momentumX.value() / (n * dr_);
+  o.momentumY = hbar * sums.momentumY.value() / (n * dr_);
+  const double momentumSqr = -hbar * hbar * sums.kinetic.value() / n;
+  const double meanSqr = o.momentumX * o.momentumX + o.momentumY * o.momentumY;
+  o.momentumSpread = sqrt(std::max(0.0, momentumSqr - meanSqr));
+  circularStats(sums.cosX.value() / n, sums.sinX.value() / n, width_ * dr_,
+                o.centerX, o.spreadX);
+  circularStats(sums.cosY.value() / n, sums.sinY.value() / n, height_ * dr_,
+                o.centerY, o.spreadY);
 }
 
 // Compute the Laplacian of the gravitational potential.
 void Wave::calcLaplaceV(Field<double> &laplaceV) const {
   const double factor = 4 * M_PI * GRAVITATIONAL_CONST * m_;
-  for (int x = 0; x < width_; x++) {
-    for (int y = 0; y < height_; y++) {
-      laplaceV.set(x, y, factor * abs(psi_.get(x, y)));
+  pool_.forBands(0, height_, [&](int, int first, int last) {
+    for (int y = first; y < last; y++) {
+      for (int x = 0; x < width_; x++) {
+        laplaceV.set(x, y, factor * abs(psi_.get(x, y)));
+      }
     }
-  }
+  });
   laplaceV.fillBorder();
 }
 
 // Solve the Poisson equation to compute the potential given its Laplacian.
 void Wave::calcV(const Field<double> &laplaceV) {
-  double sqrerr;
-  double norm;
+  switch (order_) {
+  case 2:
+    calcV<2>(laplaceV);
+    break;
+  case 4:
+    calcV<4>(laplaceV);
+    break;
+  case 6:
+    calcV<6>(laplaceV);
+    break;
+  }
+}
+
+template <int order> void Wave::calcV(const Field<double> &laplaceV) {
+  std::array<double, 2> change;
   do {
-    sqrerr = 0;
-    norm = 0;
-    for (int x = 0; x < width_; x++) {
-      for (int y = 0; y < height_; y++) {
-        double newV =
-            0.25 * (dynPotential_.get(x - 1, y) + dynPotential_.get(x + 1, y) +
-                    dynPotential_.get(x, y - 1) + dynPotential_.get(x, y + 1) -
-                    laplaceV.get(x, y) * dr_ * dr_);
-        tmpPotential_.set(x, y, newV);
-        norm += newV * newV;
-        double oldV = dynPotential_.get(x, y);
-        sqrerr += (oldV - newV) * (oldV - newV);
-      }
-    }
+    // The squared change and the squared norm of the new potential.
+    change = reduceBands<2>(
+        pool_, height_, [&](int, int first, int last, double *sums) {
+          for (int y = first; y < last; y++) {
+            for (int x = 0; x < width_; x++) {
+              double newV = Stencil<order>::jacobi(
+                  dynPotential_, x, y, laplaceV.get(x, y) * dr_ * dr_);
+              tmpPotential_.set(x, y, newV);
+              double oldV = dynPotential_.get(x, y);
+              sums[0] += (oldV - newV) * (oldV - newV);
+              sums[1] += newV * newV;
+            }
+          }
+        });
     tmpPotential_.fillBorder();
     dynPotential_.set(tmpPotential_);
-  } while (sqrerr > norm * 0.0001);
-  dynPotential_.add(-dynPotential_.sum() / (width_ * height_));
+  } while (change[0] > change[1] * 0.0001);
+  dynPotential_.add(-mean(pool_, dynPotential_));
+}
+
+void Wave::solvePoisson(const Field<double> &laplaceV, double tolerance,
+                        vector<Field<double>> &work) {
+  switch (order_) {
+  case 2:
+    solvePoisson<2>(laplaceV, tolerance, work);
+    break;
+  case 4:
+    solvePoisson<4>(laplaceV, tolerance, work);
+    break;
+  case 6:
+    solvePoisson<6>(laplaceV, tolerance, work);
+    break;
+  }
+}
+
+// Solve the Poisson equation with the conjugate gradient method, starting from
+// the current potential, until the norm of the residual is at most tolerance
+// times the norm of the right hand side. Unlike calcV, this checks the actual
+// residual, and the number of iterations only grows with the diameter of the
+// grid instead of its area. See:
+// https://en.wikipedia.org/wiki/Conjugate_gradient_method
+//
+// The method needs a positive semidefinite operator, so it solves
+// -poisson(v) = -rhs. On the torus, its kernel are the constants, so the
+// right hand side's mean is removed, and so is the potential's. The work
+// vector holds three fields for the residual and the search direction.
+template <int order>
+void Wave::solvePoisson(const Field<double> &laplaceV, double tolerance,
+                        vector<Field<double>> &work) {
+  Field<double> &r = work[0];
+  Field<double> &p = work[1];
+  Field<double> &ap = work[2];
+  const double drdr = dr_ * dr_;
+  const double meanRhs = mean(pool_, laplaceV);
+  const std::array<double, 2> initial = reduceBands<2>(
+      pool_, height_, [&](int, int first, int last, double *sums) {
+        for (int y = first; y < last; y++) {
+          for (int x = 0; x < width_; x++) {
+            const double rhs = (laplaceV.get(x, y) - meanRhs) * drdr;
+            const double rXY =
+                Stencil<order>::poisson(dynPotential_, x, y) - rhs;
+            r.set(x, y, rXY);
+            p.set(x, y, rXY);
+            sums[0] += rXY * rXY;
+            sums[1] += rhs * rhs;
+          }
+        }
+      });
+  p.fillBorder();
+  const double maxRSqr = tolerance * tolerance * initial[1];
+  double rSqr = initial[0];
+  for (int i = 0; i < width_ * height_ && rSqr > maxRSqr; i++) {
+    const double pAp = reduceBands<1>(
+        pool_, height_, [&](int, int first, int last, double *sums) {
+          for (int y = first; y < last; y++) {
+            for (int x = 0; x < width_; x++) {
+              const double apXY = -Stencil<order>::poisson(p, x, y);
+              ap.set(x, y, apXY);
+              sums[0] += p.get(x, y) * apXY;
+            }
+          }
+        })[0];
+    if (pAp <= 0) {
+      break;
+    }
+    const double alpha = rSqr / pAp;
+    const double newRSqr = reduceBands<1>(
+        pool_, height_, [&](int, int first, int last, double *sums) {
+          for (int y = first; y < last; y++) {
+            for (int x = 0; x < width_; x++) {
+              dynPotential_.set(x, y,
+                                dynPotential_.get(x, y) + alpha * p.get(x, y));
+              const double rXY = r.get(x, y) - alpha * ap.get(x, y);
+              r.set(x, y, rXY);
+              sums[0] += rXY * rXY;
+            }
+          }
+        })[0];
+    const double beta = newRSqr / rSqr;
+    rSqr = newRSqr;
+    pool_.forBands(0, height_, [&](int, int first, int last) {
+      for (int y = first; y < last; y++) {
+        for (int x = 0; x < width_; x++) {
+          p.set(x, y, r.get(x, y) + beta * p.get(x, y));
+        }
+      }
+    });
+    p.fillBorder();
+  }
+  dynPotential_.add(-mean(pool_, dynPotential_));
+  dynPotential_.fillBorder();
 }
 
 void Wave::evolve() {
@@ -96,89 +397,622 @@ void Wave::evolve() {
   calcV(tmpReal_);
   // Compute the next time step using the RK4 method. See:
   // https://en.wikipedia.org/wiki/Runge-Kutta_methods
-  calcK(tmpPsi_[0], psi_, 0.0);
+  calcFirstK(tmpPsi_[0]);
   calcK(tmpPsi_[1], tmpPsi_[0], 0.5 * dt_);
   calcK(tmpPsi_[2], tmpPsi_[1], 0.5 * dt_);
   calcK(tmpPsi_[3], tmpPsi_[2], dt_);
-  for (int x = 0; x < width_; x++) {
-    for (int y = 0; y < height_; y++) {
-      dcomp tp0 = tmpPsi_[0].get(x, y);
-      dcomp tp1 = tmpPsi_[1].get(x, y);
-      dcomp tp2 = tmpPsi_[2].get(x, y);
-      dcomp tp3 = tmpPsi_[3].get(x, y);
-      dcomp avgTp = (tp0 + tp1 * 2.0 + tp2 * 2.0 + tp3) / 6.0;
-      psi_.set(x, y, psi_.get(x, y) + dt_ * avgTp);
+  pool_.forBands(0, height_, [&](int, int first, int last) {
+    for (int y = first; y < last; y++) {
+      for (int x = 0; x < width_; x++) {
+        dcomp tp0 = tmpPsi_[0].get(x, y);
+        dcomp tp1 = tmpPsi_[1].get(x, y);
+        dcomp tp2 = tmpPsi_[2].get(x, y);
+        dcomp tp3 = tmpPsi_[3].get(x, y);
+        dcomp avgTp = (tp0 + tp1 * 2.0 + tp2 * 2.0 + tp3) / 6.0;
+        psi_.set(x, y, psi_.get(x, y) + dt_ * avgTp);
+      }
     }
+  });
+  psi_.fillBorder();
+  step_++;
+}
+
+void Wave::normalize(bool limitAmplitude) {
+  const double sintegral = reduceBands<1>(
+      pool_, height_, [&](int, int first, int last, double *sums) {
+        for (int y = first; y < last; y++) {
+          for (int x = 0; x < width_; x++) {
+            dcomp c = psi_.get(x, y);
+            double nc = norm(c);
+            if (limitAmplitude && nc > maxAbs_ * maxAbs_) {
+              c *= maxAbs_ / sqrt(nc);
+              nc = maxAbs_ * maxAbs_;
+              psi_.set(x, y, c);
+            }
+            sums[0] += nc;
+          }
+        }
+      })[0];
+  const double a = sqrt(sintegral) * dr_;
+  if (a > 0) {
+    const double qa = 1.0 / a;
+    pool_.forBands(0, height_, [&](int, int first, int last) {
+      for (int y = first; y < last; y++) {
+        for (int x = 0; x < width_; x++) {
+          dcomp c = psi_.get(x, y);
+          psi_.set(x, y, c * qa);
+        }
+      }
+    });
   }
   psi_.fillBorder();
 }
 
-void Wave::normalize() {
-  double sintegral = 0;
-  for (int x = 0; x < width_; x++) {
-    for (int y = 0; y < height_; y++) {
-      dcomp c = psi_.get(x, y);
-      double nc = norm(c);
-      if (nc > maxAbs_ * maxAbs_) {
-        c *= maxAbs_ / sqrt(nc);
-        nc = maxAbs_ * maxAbs_;
-        psi_.set(x, y, c);
+double Wave::laplaceSpectralRadius() const {
+  switch (order_) {
+  case 4:
+    return Stencil<4>::spectralRadius();
+  case 6:
+    return Stencil<6>::spectralRadius();
+  default:
+    return Stencil<2>::spectralRadius();
+  }
+}
+
+void Wave::applyH(const Field<dcomp> &f, Field<dcomp> &result) const {
+  switch (order_) {
+  case 2:
+    applyH<2>(f, result);
+    break;
+  case 4:
+    applyH<4>(f, result);
+    break;
+  case 6:
+    applyH<6>(f, result);
+    break;
+  }
+}
+
+// Apply the Hamiltonian, divided by the Planck constant, to f. This is i times
+// the time derivative that calcDPsiXY computes.
+template <int order>
+void Wave::applyH(const Field<dcomp> &f, Field<dcomp> &result) const {
+  pool_.forBands(0, height_, [&](int, int first, int last) {
+    for (int y = first; y < last; y++) {
+      for (int x = 0; x < width_; x++) {
+        const dcomp laplaceXY = Stencil<order>::laplace(f, x, y) * qdrdr_;
+        const double VXY = potential_.get(x, y) + dynPotential_.get(x, y);
+        result.set(x, y, I * calcDPsiXY(laplaceXY, f.get(x, y), VXY));
+      }
+    }
+  });
+}
+
+// Find the eigenvector c for the smallest eigenvalue of the generalized
+// eigenproblem a * c = lambda * b * c, where a and b are symmetric k * k
+// matrices, k <= 3, stored row by row with a stride of 3, and b is positive
+// definite. Returns false if b is too close to singular.
+static bool smallestEigenvector(const double a[9], const double b[9], int k,
+                                double c[3]) {
+  const int stride = 3;
+  // Cholesky decomposition b = l * l^T.
+  double l[9] = {0};
+  for (int i = 0; i < k; i++) {
+    for (int j = 0; j <= i; j++) {
+      double sum = b[i * stride + j];
+      for (int n = 0; n < j; n++) {
+        sum -= l[i * stride + n] * l[j * stride + n];
+      }
+      if (i == j) {
+        if (sum <= 1e-12 * b[i * stride + i]) {
+          return false;
+        }
+        l[i * stride + i] = sqrt(sum);
+      } else {
+        l[i * stride + j] = sum / l[j * stride + j];
       }
-      sintegral += nc;
     }
   }
-  const double a = sqrt(sintegral) * dr_;
-  if (a > 0) {
-    const double qa = 1.0 / a;
-    for (int x = 0; x < width_; x++) {
-      for (int y = 0; y < height_; y++) {
-        dcomp c = psi_.get(x, y);
-        psi_.set(x, y, c * qa);
+  // The symmetric matrix m = l^-1 * a * l^-T, with the same eigenvalues.
+  double la[9]; // l^-1 * a
+  for (int col = 0; col < k; col++) {
+    for (int i = 0; i < k; i++) {
+      double sum = a[i * stride + col];
+      for (int n = 0; n < i; n++) {
+        sum -= l[i * stride + n] * la[n * stride + col];
       }
+      la[i * stride + col] = sum / l[i * stride + i];
     }
   }
-  psi_.fillBorder();
+  double m[9];
+  for (int row = 0; row < k; row++) {
+    for (int i = 0; i < k; i++) {
+      double sum = la[row * stride + i];
+      for (int n = 0; n < i; n++) {
+        sum -= l[i * stride + n] * m[row * stride + n];
+      }
+      m[row * stride + i] = sum / l[i * stride + i];
+    }
+  }
+  // Diagonalize m with Jacobi rotations, accumulating them in v.
+  double v[9] = {0};
+  for (int i = 0; i < k; i++) {
+    v[i * stride + i] = 1;
+  }
+  for (int sweep = 0; sweep < 50; sweep++) {
+    double offDiagonal = 0;
+    for (int p = 0; p < k; p++) {
+      for (int q = p + 1; q < k; q++) {
+        offDiagonal += fabs(m[p * stride + q]);
+      }
+    }
+    if (offDiagonal == 0) {
+      break;
+    }
+    for (int p = 0; p < k; p++) {
+      for (int q = p + 1; q < k; q++) {
+        if (m[p * stride + q] == 0) {
+          continue;
+        }
+        const double theta =
+            (m[q * stride + q] - m[p * stride + p]) / (2 * m[p * stride + q]);
+        const double t = (theta >= 0 ? 1 : -1) /
+                         (fabs(theta) + sqrt(theta * theta + 1));
+        const double cs = 1 / sqrt(t * t + 1);
+        const double sn = t * cs;
+        for (int n = 0; n < k; n++) {
+          const double mnp = m[n * stride + p];
+          const double mnq = m[n * stride + q];
+          m[n * stride + p] = cs * mnp - sn * mnq;
+          m[n * stride + q] = sn * mnp + cs * mnq;
+        }
+        for (int n = 0; n < k; n++) {
+          const double mpn = m[p * stride + n];
+          const double mqn = m[q * stride + n];
+          m[p * stride + n] = cs * mpn - sn * mqn;
+          m[q * stride + n] = sn * mpn + cs * mqn;
+        }
+        for (int n = 0; n < k; n++) {
+          const double vnp = v[n * stride + p];
+          const double vnq = v[n * stride + q];
+          v[n * stride + p] = cs * vnp - sn * vnq;
+          v[n * stride + q] = sn * vnp + cs * vnq;
+        }
+      }
+    }
+  }
+  int smallest = 0;
+  for (int i = 1; i < k; i++) {
+    if (m[i * stride + i] < m[smallest * stride + smallest]) {
+      smallest = i;
+    }
+  }
+  // Transform the eigenvector back: c = l^-T * y.
+  for (int i = k - 1; i >= 0; i--) {
+    double sum = v[i * stride + smallest];
+    for (int n = i + 1; n < k; n++) {
+      sum -= l[n * stride + i] * c[n];
+    }
+    c[i] = sum / l[i * stride + i];
+  }
+  return true;
 }
 
-void Wave::addBump(int x, int y, dcomp c, int size) {
-  c /= sarea_;
+// The largest relative residual of the Poisson equation in findGroundState.
+static const double MAX_POISSON_TOLERANCE = 1e-3;
+
+// Imaginary time evolution moves the wave function along the residual
+//   r = H psi / hbar - mu psi,
+// where mu is the energy expectation that keeps the norm constant, i.e. the
+// gradient of the energy on the unit sphere. The number of steps it needs grows
+// with the ratio of the largest eigenvalue to the gap above the ground state.
+//
+// The locally optimal conjugate gradient method (LOBPCG with a single vector)
+// instead chooses the lowest energy state in the span of psi, r and the
+// previous step p, which only needs about the square root of that number of
+// iterations. See:
+// https://en.wikipedia.org/wiki/LOBPCG
+//
+// The gravitational potential is solved for from the current state in every
+// iteration, so the Hamiltonian changes slightly between iterations. Solving it
+// more accurately than the state itself is would not speed up convergence, so
+// the Poisson tolerance follows the residual.
+GroundStateResult Wave::findGroundState(const GroundStateConfig &config) {
+  const double hbar = PLANCK_CONST / (2.0 * M_PI);
+  const double hm = PLANCK_CONST / (2.0 * M_PI * m_);
+  const double kineticRadius = hm * qdrdr_ * laplaceSpectralRadius();
+  // H / hbar applied to psi, the residual r and the search direction p.
+  Field<dcomp> &hpsi = tmpPsi_[0];
+  Field<dcomp> &r = tmpPsi_[1];
+  Field<dcomp> &p = tmpPsi_[2];
+  Field<dcomp> &hr = tmpPsi_[3];
+  Field<dcomp> hp(width_, height_, border_, boundary_, &pool_);
+  vector<Field<double>> poissonWork;
+  // Reserve, as reallocation calls the Field destructor.
+  poissonWork.reserve(3);
+  for (int i = 0; i < 3; i++) {
+    poissonWork.emplace_back(width_, height_, border_, boundary_, &pool_);
+  }
+  bool hasP = false;
+  // Whether the tolerances were reached with a less accurate potential.
+  bool converging = false;
+  double minResidual = INFINITY;
+  int minResidualIteration = 0;
+  GroundStateResult result = {false, 0, 0, 0, 0};
+  normalize(false);
+  for (result.iterations = 0; result.iterations < config.maxIterations;
+       result.iterations++) {
+    // Solve the Poisson equation only as accurately as the current state is,
+    // and as accurately as configured for the final iterations.
+    const double poissonTolerance =
+        converging ? config.poissonTolerance
+                   : std::max(config.poissonTolerance,
+                              std::min(MAX_POISSON_TOLERANCE,
+                                       result.iterations == 0
+                                           ? MAX_POISSON_TOLERANCE
+                                           : result.residual));
+    calcLaplaceV(tmpReal_);
+    solvePoisson(tmpReal_, poissonTolerance, poissonWork);
+    // The first Runge-Kutta stage is -i H psi / hbar, and yields the energy.
+    calcFirstK(hpsi);
+    const double prevEnergy = result.energy;
+    result.energy = observables_.energy;
+    result.energyChange =
+        fabs(result.energy - prevEnergy) / fabs(result.energy);
+    // Compute mu, and the range of the potential for the step size.
+    vector<double> bandMinV(pool_.size(), INFINITY);
+    vector<double> bandMaxV(pool_.size(), -INFINITY);
+    const std::array<double, 1> psiH = reduceBands<1>(
+        pool_, height_, [&](int band, int first, int last, double *sums) {
+          double minV = INFINITY;
+          double maxV = -INFINITY;
+          for (int y = first; y < last; y++) {
+            for (int x = 0; x < width_; x++) {
+              const dcomp hpsiXY = I * hpsi.get(x, y);
+              hpsi.set(x, y, hpsiXY);
+              sums[0] += (conj(psi_.get(x, y)) * hpsiXY).real();
+              const double VXY =
+                  potential_.get(x, y) + dynPotential_.get(x, y);
+              minV = std::min(minV, VXY);
+              maxV = std::max(maxV, VXY);
+            }
+          }
+          bandMinV[band] = minV;
+          bandMaxV[band] = maxV;
+        });
+    const double mu = psiH[0] * dr_ * dr_;
+    const double minV = *std::min_element(bandMinV.begin(), bandMinV.end());
+    const double maxV = *std::max_element(bandMaxV.begin(), bandMaxV.end());
+    // The largest eigenvalue of H / hbar - mu.
+    const double radius = kineticRadius + (maxV - minV) / hbar;
+    const std::array<double, 1> rr = reduceBands<1>(
+        pool_, height_, [&](int, int first, int last, double *sums) {
+          for (int y = first; y < last; y++) {
+            for (int x = 0; x < width_; x++) {
+              const dcomp rXY = hpsi.get(x, y) - mu * psi_.get(x, y);
+              r.set(x, y, rXY);
+              sums[0] += norm(rXY);
+            }
+          }
+        });
+    r.fillBorder();
+    result.residual = sqrt(rr[0]) * dr_ / radius;
+    if (result.iterations > 0 &&
+        result.energyChange <= config.energyTolerance &&
+        result.residual <= config.residualTolerance) {
+      if (poissonTolerance <= config.poissonTolerance) {
+        result.converged = true;
+        break;
+      }
+      converging = true;
+    }
+    if (result.residual < minResidual) {
+      minResidual = result.residual;
+      minResidualIteration = result.iterations;
+    } else if (result.iterations - minResidualIteration >=
+               config.stallIterations) {
+      break;
+    }
+    if (config.progress && !config.progress(result)) {
+      break;
+    }
+    // Fall back to steepest descent if the energy increased.
+    if (result.energy > prevEnergy) {
+      hasP = false;
+    }
+    bool steepestDescent = true;
+    double cPsi = 1;
+    double cR = 0;
+    double cP = 0;
+    if (config.conjugateGradient && rr[0] > 0) {
+      // The Rayleigh-Ritz method in the span of psi, r and p: a is the matrix
+      // of H / hbar, b the Gram matrix, each restricted to that span.
+      applyH(r, hr);
+      if (hasP) {
+        applyH(p, hp);
+      }
+      int n = hasP ? 3 : 2;
+      const Field<dcomp> *basis[3] = {&psi_, &r, &p};
+      const Field<dcomp> *hBasis[3] = {&hpsi, &hr, &hp};
+      // The upper triangles of a and b, row by row.
+      const std::array<double, 12> gram = reduceBands<12>(
+          pool_, height_, [&](int, int first, int last, double *sums) {
+            for (int y = first; y < last; y++) {
+              for (int x = 0; x < width_; x++) {
+                dcomp s[3];
+                dcomp hs[3];
+                for (int i = 0; i < n; i++) {
+                  s[i] = basis[i]->get(x, y);
+                  hs[i] = hBasis[i]->get(x, y);
+                }
+                int k = 0;
+                for (int i = 0; i < n; i++) {
+                  for (int j = i; j < n; j++, k++) {
+                    sums[k] += (conj(s[i]) * hs[j]).real();
+                    sums[6 + k] += (conj(s[i]) * s[j]).real();
+                  }
+                }
+              }
+            }
+          });
+      // Scale the basis to norm 1, to make the small matrices well-conditioned.
+      double scale[3];
+      double a[9];
+      double b[9];
+      for (int i = 0, k = 0; i < n; i++) {
+        scale[i] = 1.0 / sqrt(gram[6 + k]);
+        k += n - i;
+      }
+      for (int i = 0, k = 0; i < n; i++) {
+        for (int j = i; j < n; j++, k++) {
+          a[i * 3 + j] = a[j * 3 + i] = gram[k] * scale[i] * scale[j];
+          b[i * 3 + j] = b[j * 3 + i] = gram[6 + k] * scale[i] * scale[j];
+        }
+      }
+      // If p is nearly parallel to psi and r, drop it. If r is, psi is an
+      // eigenvector and only the potential still changes, so take a plain
+      // imaginary time step.
+      double c[3];
+      while (n > 1 && !smallestEigenvector(a, b, n, c)) {
+        n--;
+      }
+      if (n > 1) {
+        steepestDescent = false;
+        cPsi = c[0] * scale[0];
+        cR = c[1] * scale[1];
+        cP = n > 2 ? c[2] * scale[2] : 0;
+      }
+    }
+    if (steepestDescent) {
+      // Explicit steps are stable if the step size times the largest
+      // eigenvalue of H / hbar - mu is less than 2.
+      cR = -config.stepFactor * 2.0 / radius;
+    }
+    pool_.forBands(0, height_, [&](int, int first, int last) {
+      for (int y = first; y < last; y++) {
+        for (int x = 0; x < width_; x++) {
+          const dcomp step =
+              cR * r.get(x, y) + (cP == 0 ? dcomp(0) : cP * p.get(x, y));
+          p.set(x, y, step);
+          psi_.set(x, y, cPsi * psi_.get(x, y) + step);
+        }
+      }
+    });
+    p.fillBorder();
+    hasP = config.conjugateGradient;
+    normalize(false);
+  }
+  return result;
+}
+
+// The magic number at the beginning of a file written by savePsi().
+static const char PSI_FILE_MAGIC[8] = {'S', 'C', 'H', 'R', 'P', 'S', 'I', '2'};
+
+// Write the cells of the main rectangle of the field, row by row.
+template <typename T>
+static void writeCells(std::ofstream &file, const Field<T> &field) {
+  const FieldView<T> view = field.view();
+  for (int y = 0; y < view.height; y++) {
+    file.write(reinterpret_cast<const char *>(view.origin + y * view.stride),
+               sizeof(T) * view.width);
+  }
+}
+
+// Read the cells written by writeCells() for a field of the given size.
+template <typename T>
+static bool readCells(std::ifstream &file, int width, int height,
+                      vector<T> &cells) {
+  cells.resize(static_cast<size_t>(width) * height);
+  file.read(reinterpret_cast<char *>(cells.data()), sizeof(T) * cells.size());
+  return static_cast<bool>(file);
+}
+
+// Set the cells of the main rectangle of the field and fill its border.
+template <typename T>
+static void setCells(Field<T> &field, const vector<T> &cells) {
+  for (int y = 0; y < field.height; y++) {
+    for (int x = 0; x < field.width; x++) {
+      field.set(x, y, cells[x + y * field.width]);
+    }
+  }
+  field.fillBorder();
+}
+
+bool Wave::savePsi(const std::string &path) const {
+  std::ofstream file(path, std::ios::binary);
+  const int32_t size[2] = {width_, height_};
+  file.write(PSI_FILE_MAGIC, sizeof(PSI_FILE_MAGIC));
+  file.write(reinterpret_cast<const char *>(size), sizeof(size));
+  writeCells(file, psi_);
+  writeCells(file, potential_);
+  writeCells(file, dynPotential_);
+  return file.good();
+}
+
+bool Wave::loadPsi(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(PSI_FILE_MAGIC)];
+  int32_t size[2];
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char *>(size), sizeof(size));
+  if (!file || !std::equal(magic, magic + sizeof(magic), PSI_FILE_MAGIC) ||
+      size[0] != width_ || size[1] != height_) {
+    return false;
+  }
+  vector<dcomp> psi;
+  vector<double> potential, dynPotential;
+  if (!readCells(file, width_, height_, psi) ||
+      !readCells(file, width_, height_, potential) ||
+      !readCells(file, width_, height_, dynPotential)) {
+    return false;
+  }
+  setCells(psi_, psi);
+  setCells(potential_, potential);
+  setCells(dynPotential_, dynPotential);
+  return true;
+}
+
+template <typename F>
+void Wave::forBump(int x, int y, int size, F f) const {
+  size = std::min(size, std::max(width_, height_) / 2);
+  mod(x, width_);
+  mod(y, height_);
   for (int dx = -size; dx <= size; dx++) {
     for (int dy = -size; dy <= size; dy++) {
-      double rr = (dx * dx + dy * dy) / static_cast<double>(size * size);
+      const double rx = dx, ry = dy;
+      double rr = (rx * rx + ry * ry) / (static_cast<double>(size) * size);
       if (rr < 1.0) {
-        double mx = (x + dx + width_) % width_;
-        double my = (y + dy + height_) % height_;
-        dcomp oldc = psi_.get(mx, my);
-        psi_.set(mx, my, oldc + c * (1.0 - sqrt(rr)));
+        int mx = x + dx;
+        int my = y + dy;
+        mod(mx, width_);
+        mod(my, height_);
+        f(mx, my, 1.0 - sqrt(rr));
       }
     }
   }
 }
 
+void Wave::addBump(int x, int y, dcomp c, int size) {
+  c /= sarea_;
+  forBump(x, y, size, [&](int mx, int my, double value) {
+    psi_.set(mx, my, psi_.get(mx, my) + c * value);
+  });
+}
+
 // Multiplier for the potential field, in 1 / J.
 static const double POTENTIAL_UNIT = 1e35;
 
 void Wave::addPotentialBump(int x, int y, double c, int size) {
   c /= POTENTIAL_UNIT * area_ * dt_;
-  for (int dx = -size; dx <= size; dx++) {
-    for (int dy = -size; dy <= size; dy++) {
-      double rr = (dx * dx + dy * dy) / (static_cast<double>(size) * size);
-      if (rr < 1.0) {
-        double mx = (x + dx + width_) % width_;
-        double my = (y + dy + height_) % height_;
-        double oldc = potential_.get(mx, my);
-        potential_.set(mx, my, std::max(oldc, c * (1.0 - sqrt(rr))));
-      }
-    }
+  forBump(x, y, size, [&](int mx, int my, double value) {
+    potential_.set(mx, my, std::max(potential_.get(mx, my), c * value));
+  });
+}
+
+void Wave::addBumps(const Bump *bumps, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    addBump(bumps[i].x, bumps[i].y, bumps[i].c, bumps[i].size);
   }
+  psi_.fillBorder();
+}
+
+void Wave::addPotentialBumps(const PotentialBump *bumps, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    addPotentialBump(bumps[i].x, bumps[i].y, bumps[i].c, bumps[i].size);
+  }
+  potential_.fillBorder();
+}
+
+const Observables &Wave::observables() const { return observables_; }
+
+double Wave::mass() const { return m_; }
+
+FieldView<dcomp> Wave::psi() const { return psi_.view(); }
+
+FieldView<double> Wave::potential() const { return potential_.view(); }
+
+FieldView<double> Wave::dynPotential() const { return dynPotential_.view(); }
+
+std::string Wave::placementStats() const {
+  std::map<int, long> counts;
+  countPageNodes(psi_.frame(), psi_.framesize * sizeof(dcomp), counts);
+  countPageNodes(potential_.frame(), potential_.framesize * sizeof(double),
+                 counts);
+  countPageNodes(dynPotential_.frame(),
+                 dynPotential_.framesize * sizeof(double), counts);
+  countPageNodes(tmpPotential_.frame(),
+                 tmpPotential_.framesize * sizeof(double), counts);
+  countPageNodes(tmpReal_.frame(), tmpReal_.framesize * sizeof(double), counts);
+  for (const Field<dcomp> &tmpPsi : tmpPsi_) {
+    countPageNodes(tmpPsi.frame(), tmpPsi.framesize * sizeof(dcomp), counts);
+  }
+  return ::placementStats(counts);
 }
 
 void Wave::draw(uint32_t *pixels, uint32_t toColor(dcomp c, double p)) const {
-  for (int x = 0; x < width_; x++) {
-    for (int y = 0; y < height_; y++) {
-      const dcomp psiXY = psi_.get(x, y) * sarea_;
-      const double VXY = POTENTIAL_UNIT * potential_.get(x, y) * sarea_ * dt_;
-      pixels[x + width_ * y] = toColor(psiXY, VXY);
-    }
+  draw(pixels, width_, height_, {0.0, 0.0, static_cast<double>(width_),
+                                 static_cast<double>(height_)},
+       AVERAGE, toColor);
+}
+
+// Compute the range [first, last) of cells covered by the given pixel, where
+// the pixels start at cell origin and each of them is scale cells wide. The
+// range always contains at least one cell of the n cells of the grid.
+static void pixelCells(double origin, double scale, int pixel, int n,
+                       int &first, int &last) {
+  first = static_cast<int>(floor(origin + pixel * scale));
+  last = static_cast<int>(floor(origin + (pixel + 1) * scale));
+  first = std::min(std::max(first, 0), n - 1);
+  last = std::min(std::max(last, first + 1), n);
+}
+
+void Wave::draw(uint32_t *pixels, int pixelsWidth, int pixelsHeight,
+                const Viewport &view, Reduction reduction,
+                uint32_t toColor(dcomp c, double p)) const {
+  const double potentialScale = POTENTIAL_UNIT * sarea_ * dt_;
+  // The cell columns are the same for every row of pixels.
+  vector<int> firstColumn(pixelsWidth);
+  vector<int> lastColumn(pixelsWidth);
+  for (int px = 0; px < pixelsWidth; px++) {
+    pixelCells(view.x, view.width / pixelsWidth, px, width_, firstColumn[px],
+               lastColumn[px]);
   }
+  pool_.forBands(0, pixelsHeight, [&](int, int first, int last) {
+    for (int py = first; py < last; py++) {
+      int y0, y1;
+      pixelCells(view.y, view.height / pixelsHeight, py, height_, y0, y1);
+      uint32_t *row = pixels + pixelsWidth * py;
+      for (int px = 0; px < pixelsWidth; px++) {
+        const int x0 = firstColumn[px];
+        const int x1 = lastColumn[px];
+        dcomp psiXY = 0;
+        double VXY = 0;
+        switch (reduction) {
+        case AVERAGE:
+          for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+              psiXY += psi_.get(x, y);
+              VXY += potential_.get(x, y);
+            }
+          }
+          psiXY /= (x1 - x0) * (y1 - y0);
+          VXY /= (x1 - x0) * (y1 - y0);
+          break;
+        case MAX_AMPLITUDE:
+          VXY = -INFINITY;
+          for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+              const dcomp c = psi_.get(x, y);
+              if (norm(c) >= norm(psiXY)) {
+                psiXY = c;
+              }
+              VXY = std::max(VXY, potential_.get(x, y));
+            }
+          }
+          break;
+        }
+        row[px] = toColor(psiXY * sarea_, VXY * potentialScale);
+      }
+    }
+  });
 }
@@ -2,9 +2,12 @@
 #define SCHROEDINGER_WAVE_H
 
 #include <complex>
+#include <functional>
+#include <string>
 #include <vector>
 
 #include "Field.h"
+#include "ThreadPool.h"
 
 typedef std::complex<double> dcomp;
 
@@ -13,45 +16,241 @@ const double PLANCK_CONST = 6.62606957e-34;
 /// Gravitational constant in Nm²/kg².
 const double GRAVITATIONAL_CONST = 6.673e-11;
 
+/// How to combine the cells that fall into a single pixel when drawing.
+enum Reduction {
+  AVERAGE,       ///< Box filter: the mean wave function and potential.
+  MAX_AMPLITUDE, ///< The cell with the largest amplitude, and the maximum
+                 ///< potential.
+};
+
+/// A rectangular region of the grid, in cell coordinates.
+struct Viewport {
+  double x;      ///< The left edge.
+  double y;      ///< The top edge.
+  double width;  ///< The number of cells in a row of the region.
+  double height; ///< The number of cells in a column of the region.
+};
+
+/// The parameters of a simulation. See the Wave constructor.
+struct WaveConfig {
+  int width = 256;
+  int height = 128;
+  int order = 2;
+  int threads = 0;
+  Pinning pinning = NO_PINNING;
+};
+
+/// A bump function to be added to the wave, see Wave::addBump.
+struct Bump {
+  int x;
+  int y;
+  dcomp c;
+  int size;
+};
+
+/// A bump function to be added to the static potential, see
+/// Wave::addPotentialBump.
+struct PotentialBump {
+  int x;
+  int y;
+  double c;
+  int size;
+};
+
+/// Physical quantities of the wave, in SI units, at the beginning of a time
+/// step. The energies follow the Hamiltonian that evolve() discretizes, and
+/// positions are measured from the top left corner of the grid. As the grid is
+/// toroidal, the center and spread of the position are circular statistics.
+struct Observables {
+  long step = 0;             ///< The number of time steps computed before.
+  double time = 0;           ///< The simulated time in s.
+  double norm = 0;           ///< The integral of the squared amplitude.
+  double kinetic = 0;        ///< The kinetic energy.
+  double potential = 0;      ///< The energy in the static potential.
+  double selfEnergy = 0;     ///< The gravitational self-energy.
+  double energy = 0;         ///< The total energy.
+  double centerX = 0;        ///< The center of mass.
+  double centerY = 0;        ///< The center of mass.
+  double spreadX = 0;        ///< The standard deviation of the position.
+  double spreadY = 0;        ///< The standard deviation of the position.
+  double momentumX = 0;      ///< The expected momentum.
+  double momentumY = 0;      ///< The expected momentum.
+  double momentumSpread = 0; ///< The standard deviation of the momentum.
+};
+
+/// The outcome of Wave::findGroundState.
+struct GroundStateResult {
+  bool converged;      ///< Whether the tolerances were reached.
+  int iterations;      ///< The number of iterations computed.
+  double energy;       ///< The energy of the final state, in J.
+  double energyChange; ///< The relative energy change in the last iteration.
+  /// The norm of H psi - E psi in the last iteration, relative to the largest
+  /// eigenvalue of H - E.
+  double residual;
+};
+
+/// The parameters of Wave::findGroundState.
+struct GroundStateConfig {
+  /// The maximum number of iterations.
+  int maxIterations = 100000;
+  /// Stop when the energy changes by at most this fraction in an iteration,
+  double energyTolerance = 1e-10;
+  /// and the residual is at most this. See GroundStateResult::residual.
+  double residualTolerance = 1e-8;
+  /// Give up if the residual has not reached a new minimum in this many
+  /// iterations. The gravitational potential is sourced by |psi|, not |psi|²,
+  /// so the iteration does not minimize a fixed functional, and can drift
+  /// instead of converging, e.g. if the state is hardly wider than a cell.
+  int stallIterations = 1000;
+  /// Whether to use the locally optimal conjugate gradient method. Otherwise,
+  /// use plain imaginary time evolution.
+  bool conjugateGradient = true;
+  /// The imaginary time step, relative to the largest stable one.
+  double stepFactor = 0.9;
+  /// The norm of the Poisson equation's residual, relative to its right hand
+  /// side. Unlike during the time evolution, the equation is solved with the
+  /// conjugate gradient method, as the ground state depends on the exact
+  /// potential.
+  double poissonTolerance = 1e-10;
+  /// If set, this is called before each iteration, with the current state.
+  /// Returning false stops the search.
+  std::function<bool(const GroundStateResult &)> progress;
+};
+
 /// A wave function of a single, non-relativistic particle, represented as a
 /// cellular automaton with complex-valued cells.
 class Wave {
 public:
-  Wave(int width, int height);
+  /// Create a wave on a width * height grid, discretized with stencils of the
+  /// given order of accuracy: 2, 4 or 6. The solver's sweeps are split into
+  /// bands of rows, run by the given number of threads (0 means one per
+  /// hardware thread) with the given pinning. The fields' memory is first
+  /// touched by the thread that owns the corresponding band. Throws
+  /// std::length_error if the grid is too large to be indexed with ints.
+  Wave(int width, int height, int order = 2, int threads = 0,
+       Pinning pinning = NO_PINNING);
+  /// Create a wave with the given parameters.
+  explicit Wave(const WaveConfig &config);
   /// Compute the state of the wave in the next time step.
   void evolve();
-  /// Add c times a bump function to the wave.
+  /// Add c times a bump function to the wave. The coordinates wrap around, so
+  /// any center is valid. Sizes beyond half the larger grid dimension are
+  /// clamped to it.
   void addBump(int x, int y, dcomp c, int size);
-  /// Add c times a bump function to the static potential.
+  /// Add c times a bump function to the static potential, like addBump().
   void addPotentialBump(int x, int y, double c, int size);
-  /// Normalize the wave function, so that it has norm 1.
-  void normalize();
+  /// Add the given bump functions to the wave.
+  void addBumps(const Bump *bumps, size_t count);
+  /// Add the given bump functions to the static potential.
+  void addPotentialBumps(const PotentialBump *bumps, size_t count);
+  /// Normalize the wave function, so that it has norm 1. Unless limitAmplitude
+  /// is false, the amplitude of each cell is first limited, to keep the wave
+  /// drawn by the user from growing too large.
+  void normalize(bool limitAmplitude = true);
+  /// Replace the wave function with the ground state, the stationary state of
+  /// lowest energy in the current static potential and its own gravitational
+  /// potential. It is found by minimizing the energy, starting from the
+  /// current wave function: by imaginary time evolution, accelerated with the
+  /// conjugate gradient method. The state is normalized without limiting its
+  /// amplitude, so it should be normalized with limitAmplitude = false.
+  GroundStateResult findGroundState(
+      const GroundStateConfig &config = GroundStateConfig());
+  /// Write the wave function and the static and gravitational potentials to
+  /// the given file, so that a saved ground state is stationary again after
+  /// loading it. Returns false on failure.
+  ///
+  /// The file consists of the 8 bytes "SCHRPSI2", the width and height as
+  /// 32-bit integers, and the cells of the wave function (real and imaginary
+  /// part), the static potential and the gravitational potential as doubles,
+  /// each row by row. The numbers are stored in the machine's native byte
+  /// order, so the files are not portable between little- and big-endian
+  /// machines.
+  bool savePsi(const std::string &path) const;
+  /// Read the wave function and the potentials from a file written by
+  /// savePsi() for a grid of the same size. Returns false on failure, leaving
+  /// the wave unchanged. A saved ground state should be normalized with
+  /// limitAmplitude = false.
+  bool loadPsi(const std::string &path);
   /// Draw the wave function and potential using the given color mapping.
   void draw(std::uint32_t *pixels,
             std::uint32_t toColor(dcomp c, double p)) const;
+  /// Draw the given region of the wave function and potential into a buffer
+  /// of pixelsWidth * pixelsHeight pixels. Where a pixel covers several cells,
+  /// they are combined using the given reduction, so that the cost depends on
+  /// the size of the buffer rather than the size of the grid.
+  void draw(std::uint32_t *pixels, int pixelsWidth, int pixelsHeight,
+            const Viewport &view, Reduction reduction,
+            std::uint32_t toColor(dcomp c, double p)) const;
+  /// Views of the wave function, the static potential and the gravitational
+  /// potential, without copying. They remain valid as long as the wave exists,
+  /// and their border is up to date after evolve(), normalize() and adding a
+  /// batch of bumps. They must not be read while one of these is running.
+  /// After normalize(), the sum of the norms of the wave function's cells times
+  /// the cell area is 1. The potentials are energies in J.
+  FieldView<dcomp> psi() const;
+  FieldView<double> potential() const;
+  FieldView<double> dynPotential() const;
+  /// The physical quantities, as of the beginning of the last call to
+  /// evolve(), or the last iteration of findGroundState(). They are computed in
+  /// the same sweep as the first Runge-Kutta stage.
+  const Observables &observables() const;
+  /// The particle's mass in kg. The kinetic term of the Hamiltonian is
+  /// -hbar² / mass() times the Laplacian, i.e. that of a particle of half
+  /// this mass.
+  double mass() const;
+  /// Describe on which NUMA nodes the fields' pages reside.
+  std::string placementStats() const;
 
 private:
   const int width_;
   const int height_;
+  const int order_;
+  const int border_ = order_ / 2;
   const BoundaryCondition boundary_ = WRAP;
   const double area_ = 1.0; // The total area in m².
   const double sarea_ = sqrt(area_);
-  const double dr_ = sqrt(area_ / (width_ * height_));
+  const double dr_ = sqrt(area_ / (static_cast<double>(width_) * height_));
   const double qdrdr_ = 1.0 / (dr_ * dr_);
   const double maxAbs_ = 6.0 / area_;
   const double m_ = 1000 * 9.10938291e-31; // The particle's mass in kg.
   const double dt_ = 10; // The time resolution in s.
+  long step_ = 0; // The number of time steps computed so far.
+  Observables observables_;
+  // Cosine and sine of the angle of each column and row on the torus.
+  std::vector<double> cosX_, sinX_, cosY_, sinY_;
+  mutable ThreadPool pool_;
   std::vector<Field<dcomp>> tmpPsi_;
-  Field<dcomp> psi_ = Field<dcomp>(width_, height_, 1, boundary_);
-  Field<double> potential_ = Field<double>(width_, height_, 1, boundary_);
-  Field<double> dynPotential_ = Field<double>(width_, height_, 1, boundary_);
-  Field<double> tmpPotential_ = Field<double>(width_, height_, 1, boundary_);
-  Field<double> tmpReal_ = Field<double>(width_, height_, 1, boundary_);
+  Field<dcomp> psi_ =
+      Field<dcomp>(width_, height_, border_, boundary_, &pool_);
+  Field<double> potential_ =
+      Field<double>(width_, height_, border_, boundary_, &pool_);
+  Field<double> dynPotential_ =
+      Field<double>(width_, height_, border_, boundary_, &pool_);
+  Field<double> tmpPotential_ =
+      Field<double>(width_, height_, border_, boundary_, &pool_);
+  Field<double> tmpReal_ =
+      Field<double>(width_, height_, border_, boundary_, &pool_);
   dcomp calcDPsiXY(dcomp laplaceXY, dcomp psiXY, dcomp VXY) const;
   void calcK(Field<dcomp> &newk, const Field<dcomp> &oldk, double factor);
+  template <int order>
+  void calcK(Field<dcomp> &newk, const Field<dcomp> &oldk, double factor);
+  void calcFirstK(Field<dcomp> &newk);
+  template <int order> void calcFirstK(Field<dcomp> &newk);
   void calcLaplaceV(Field<double> &laplaceV) const;
   void calcV(const Field<double> &laplaceV);
-  dcomp laplace(const Field<dcomp> &f, int x, int y) const;
+  template <int order> void calcV(const Field<double> &laplaceV);
+  void solvePoisson(const Field<double> &laplaceV, double tolerance,
+                    std::vector<Field<double>> &work);
+  template <int order>
+  void solvePoisson(const Field<double> &laplaceV, double tolerance,
+                    std::vector<Field<double>> &work);
+  double laplaceSpectralRadius() const;
+  // Call f(x, y, value) for each cell of a bump function of the given size
+  // around (x, y), with wrapped coordinates.
+  template <typename F> void forBump(int x, int y, int size, F f) const;
+  void applyH(const Field<dcomp> &f, Field<dcomp> &result) const;
+  template <int order>
+  void applyH(const Field<dcomp> &f, Field<dcomp> &result) const;
 };
 
 #endif // SCHROEDINGER_WAVE_H
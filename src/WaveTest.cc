@@ -0,0 +1,257 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestCaller.h>
+#include <cppunit/TestFixture.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Wave.h"
+
+class WaveTest : public CppUnit::TestFixture {
+  CPPUNIT_TEST_SUITE(WaveTest);
+  CPPUNIT_TEST(testGroundState);
+  CPPUNIT_TEST(testGroundStateModes);
+  CPPUNIT_TEST(testSaveLoad);
+  CPPUNIT_TEST(testObservables);
+  CPPUNIT_TEST(testDraw);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+  void testGroundState();
+  void testGroundStateModes();
+  void testSaveLoad();
+  void testObservables();
+  void testDraw();
+
+private:
+  const int size = 48;
+  // Start from a single bump, with a small static potential next to it.
+  void init(Wave &wave);
+  // Draw the wave function into a buffer of the given size, and decode the
+  // pixels' values.
+  std::vector<dcomp> draw(const Wave &wave, int width, int height,
+                          const Viewport &view, Reduction reduction);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(WaveTest);
+
+void WaveTest::init(Wave &wave) {
+  wave.addPotentialBump(size / 2, size / 2, 1.0, size / 4);
+  wave.addBump(size / 4, size / 3, dcomp(1.0, 0.5), size / 6);
+}
+
+// Colors that encode the real or imaginary part of the wave function as the
+// bits of a float.
+static std::uint32_t floatBits(double d) {
+  const float f = d;
+  std::uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+static std::uint32_t realColor(dcomp c, double) { return floatBits(c.real()); }
+
+static std::uint32_t imagColor(dcomp c, double) { return floatBits(c.imag()); }
+
+static double fromBits(std::uint32_t bits) {
+  float f;
+  std::memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+std::vector<dcomp> WaveTest::draw(const Wave &wave, int width, int height,
+                                  const Viewport &view, Reduction reduction) {
+  std::vector<std::uint32_t> re(width * height);
+  std::vector<std::uint32_t> im(width * height);
+  wave.draw(re.data(), width, height, view, reduction, realColor);
+  wave.draw(im.data(), width, height, view, reduction, imagColor);
+  std::vector<dcomp> pixels;
+  for (int i = 0; i < width * height; i++) {
+    pixels.push_back(dcomp(fromBits(re[i]), fromBits(im[i])));
+  }
+  return pixels;
+}
+
+void WaveTest::testGroundState() {
+  Wave wave(size, size, 2, 1);
+  init(wave);
+  const GroundStateConfig config;
+  const GroundStateResult result = wave.findGroundState(config);
+  CPPUNIT_ASSERT(result.converged);
+  CPPUNIT_ASSERT(result.residual <= config.residualTolerance);
+  CPPUNIT_ASSERT(result.energy < 0);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, wave.observables().norm, 1e-12);
+  // The ground state is stationary: its amplitude does not change over time,
+  // also after loading it with its potentials into a new wave.
+  const char *path = "WaveTest.psi";
+  CPPUNIT_ASSERT(wave.savePsi(path));
+  Wave loaded(size, size, 2, 1);
+  CPPUNIT_ASSERT(loaded.loadPsi(path));
+  std::remove(path);
+  std::vector<double> amplitude;
+  double maxAmplitude = 0;
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      amplitude.push_back(abs(wave.psi().get(x, y)));
+      maxAmplitude = std::max(maxAmplitude, amplitude.back());
+    }
+  }
+  for (Wave *evolved : {&wave, &loaded}) {
+    for (int i = 0; i < 20; i++) {
+      evolved->normalize(false);
+      evolved->evolve();
+    }
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(amplitude[x + y * size],
+                                     abs(evolved->psi().get(x, y)),
+                                     1e-4 * maxAmplitude);
+      }
+    }
+  }
+}
+
+void WaveTest::testGroundStateModes() {
+  Wave accelerated(size, size, 2, 2);
+  Wave plain(size, size, 2, 1);
+  init(accelerated);
+  init(plain);
+  GroundStateConfig config;
+  const GroundStateResult acceleratedResult =
+      accelerated.findGroundState(config);
+  config.conjugateGradient = false;
+  const GroundStateResult plainResult = plain.findGroundState(config);
+  CPPUNIT_ASSERT(acceleratedResult.converged);
+  CPPUNIT_ASSERT(plainResult.converged);
+  CPPUNIT_ASSERT(acceleratedResult.iterations < plainResult.iterations);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(
+      1.0, acceleratedResult.energy / plainResult.energy, 1e-6);
+  // The search stops when the progress function returns false.
+  Wave stopped(size, size, 2, 1);
+  init(stopped);
+  int calls = 0;
+  config.progress = [&calls](const GroundStateResult &) {
+    return ++calls < 10;
+  };
+  const GroundStateResult stoppedResult = stopped.findGroundState(config);
+  CPPUNIT_ASSERT(!stoppedResult.converged);
+  CPPUNIT_ASSERT_EQUAL(9, stoppedResult.iterations);
+}
+
+void WaveTest::testSaveLoad() {
+  const char *path = "WaveTest.psi";
+  Wave wave(size, size, 2, 1);
+  init(wave);
+  wave.normalize();
+  // Compute the gravitational potential.
+  wave.evolve();
+  CPPUNIT_ASSERT(wave.savePsi(path));
+  Wave loaded(size, size, 2, 1);
+  CPPUNIT_ASSERT(loaded.loadPsi(path));
+  const FieldView<dcomp> psi = wave.psi();
+  const FieldView<dcomp> loadedPsi = loaded.psi();
+  const FieldView<double> potential = wave.potential();
+  const FieldView<double> loadedPotential = loaded.potential();
+  const FieldView<double> dynPotential = wave.dynPotential();
+  const FieldView<double> loadedDynPotential = loaded.dynPotential();
+  for (int y = -1; y <= size; y++) {
+    for (int x = -1; x <= size; x++) {
+      CPPUNIT_ASSERT(psi.get(x, y) == loadedPsi.get(x, y));
+      CPPUNIT_ASSERT_EQUAL(potential.get(x, y), loadedPotential.get(x, y));
+      CPPUNIT_ASSERT_EQUAL(dynPotential.get(x, y),
+                           loadedDynPotential.get(x, y));
+    }
+  }
+  Wave other(size, size / 2, 2, 1);
+  CPPUNIT_ASSERT(!other.loadPsi(path));
+  std::remove(path);
+  CPPUNIT_ASSERT(!loaded.loadPsi(path));
+}
+
+void WaveTest::testObservables() {
+  // A new wave is a plane wave with one period across the grid. Sixth order
+  // stencils make the discrete momentum and kinetic energy nearly exact.
+  const int width = 4 * size;
+  Wave wave(width, size, 6, 1);
+  wave.normalize(false);
+  wave.evolve();
+  const Observables &o = wave.observables();
+  const double hbar = PLANCK_CONST / (2.0 * M_PI);
+  // The grid has unit area.
+  const double length = width / std::sqrt(static_cast<double>(width * size));
+  const double p = hbar * 2.0 * M_PI / length;
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, o.norm, 1e-12);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, o.momentumX / p, 1e-9);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, o.momentumY / p, 1e-12);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, o.momentumSpread / p, 1e-4);
+  // The kinetic energy is p² / 2m for the effective mass m of the
+  // Hamiltonian, half the particle's mass.
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, o.kinetic / (p * p / wave.mass()), 1e-9);
+  // The center of a bump across the corner of the torus is at the corner, not
+  // in the middle of the grid.
+  Wave bump(size, size, 2, 1);
+  bump.addBump(size - 1, 1, 1e4, size / 6);
+  bump.normalize(false);
+  bump.evolve();
+  const double dr = 1.0 / size;
+  CPPUNIT_ASSERT_DOUBLES_EQUAL((size - 1) * dr, bump.observables().centerX,
+                               1e-3 * dr);
+  CPPUNIT_ASSERT_DOUBLES_EQUAL(dr, bump.observables().centerY, 1e-3 * dr);
+  CPPUNIT_ASSERT(bump.observables().spreadX < size / 6 * dr);
+  CPPUNIT_ASSERT(bump.observables().spreadY < size / 6 * dr);
+}
+
+void WaveTest::testDraw() {
+  Wave wave(size, size, 2, 1);
+  init(wave);
+  wave.normalize();
+  const FieldView<dcomp> psi = wave.psi();
+  // The grid has unit area, so the cells are drawn unscaled.
+  const double tolerance = 1e-6 * abs(psi.get(size / 4, size / 3));
+  const Viewport all = {0.0, 0.0, static_cast<double>(size),
+                        static_cast<double>(size)};
+  // At 1:1, each pixel shows its cell, whatever the reduction.
+  std::vector<std::uint32_t> re(size * size);
+  wave.draw(re.data(), realColor);
+  const std::vector<dcomp> average = draw(wave, size, size, all, AVERAGE);
+  const std::vector<dcomp> maximum = draw(wave, size, size, all, MAX_AMPLITUDE);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      const dcomp c = psi.get(x, y);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(c.real(), fromBits(re[x + y * size]),
+                                   tolerance);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, abs(c - average[x + y * size]),
+                                   tolerance);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, abs(c - maximum[x + y * size]),
+                                   tolerance);
+    }
+  }
+  // At 2:1, each pixel combines a 2 * 2 block of cells.
+  const int half = size / 2;
+  const std::vector<dcomp> mean = draw(wave, half, half, all, AVERAGE);
+  const std::vector<dcomp> largest = draw(wave, half, half, all, MAX_AMPLITUDE);
+  for (int y = 0; y < half; y++) {
+    for (int x = 0; x < half; x++) {
+      dcomp sum = 0;
+      dcomp max = 0;
+      for (int dy = 0; dy < 2; dy++) {
+        for (int dx = 0; dx < 2; dx++) {
+          const dcomp c = psi.get(2 * x + dx, 2 * y + dy);
+          sum += c;
+          // Of cells with equal amplitudes, the last one is drawn.
+          if (norm(c) >= norm(max)) {
+            max = c;
+          }
+        }
+      }
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, abs(0.25 * sum - mean[x + y * half]),
+                                   tolerance);
+      CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, abs(max - largest[x + y * half]),
+                                   tolerance);
+    }
+  }
+}
@@ -52,7 +52,30 @@ Uint32 toColor1(complex<double> c, double p) {
   return rgbToColor(c.real() + 0.5, c.imag() + 0.5, min(p, 1.0));
 }
 
-void addBump(Wave *wave, int x, int y, double scale, bool pot, bool psi) {
+// Convert window coordinates to cell coordinates within the given view.
+inline double toCell(int pos, int windowSize, double viewPos, double viewSize) {
+  return viewPos + pos * viewSize / windowSize;
+}
+
+// Zoom the view by the given factor, keeping the cell at (cx, cy) in place,
+// and keep it inside the grid.
+void zoomView(Viewport *view, double factor, double cx, double cy, int width,
+              int height) {
+  const double newWidth = min(view->width * factor, static_cast<double>(width));
+  const double newHeight =
+      min(view->height * factor, static_cast<double>(height));
+  view->x = cx - (cx - view->x) * newWidth / view->width;
+  view->y = cy - (cy - view->y) * newHeight / view->height;
+  view->width = newWidth;
+  view->height = newHeight;
+  view->x = min(max(view->x, 0.0), width - view->width);
+  view->y = min(max(view->y, 0.0), height - view->height);
+}
+
+// Add bumps to the potential and the wave function, depending on the mouse
+// buttons and the keys that are pressed. Returns whether the wave function was
+// changed.
+bool addBump(Wave *wave, double x, double y, bool pot, bool psi) {
   const Uint8 *keys = SDL_GetKeyboardState(0);
   const int size = keys[SDL_SCANCODE_SPACE] ? 20 : 6;
   const double weight =
@@ -60,34 +83,80 @@ void addBump(Wave *wave, int x, int y, double scale, bool pot, bool psi) {
   const double theta = keys[SDL_SCANCODE_P] ? clock() * 0.00002 : 0;
   const complex<double> c = polar(2.0, theta);
   if (pot) {
-    wave->addPotentialBump(x / scale, y / scale, weight, size);
+    wave->addPotentialBump(x, y, weight, size);
   }
   if (psi) {
-    wave->addBump(x / scale, y / scale, c * weight, size);
+    wave->addBump(x, y, c * weight, size);
   }
+  return psi;
 }
 
+void present(SDL_Renderer *renderer, SDL_Texture *texture, const Uint32 *pixels,
+             int textureWidth) {
+  SDL_UpdateTexture(texture, nullptr, pixels, textureWidth * sizeof(Uint32));
+  SDL_RenderClear(renderer);
+  SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+  SDL_RenderPresent(renderer);
+}
+
+// The file the ground state is saved to.
+const char GROUND_STATE_FILE[] = "ground_state.psi";
+
+// The time between frames while the ground state is computed, in ms.
+const Uint32 GROUND_STATE_FRAME_MS = 100;
+
+const char WINDOW_TITLE[] = "Schrödinger-Poisson equation";
+
 int main(int argc, char *argv[]) {
   const int width = (argc > 1) ? stoi(argv[1]) : 256;
   const int height = (argc > 2) ? stoi(argv[2]) : 128;
   const double scale = (argc > 3) ? stof(argv[3]) : 2.0;
   const bool bench = argc > 4 && strcmp(argv[4], "bench") == 0;
   const int skipFrames = 5;
+  // The solver can be configured with environment variables.
+  const char *orderEnv = getenv("SCHR_ORDER");
+  const char *threadsEnv = getenv("SCHR_THREADS");
+  const char *pinEnv = getenv("SCHR_PIN");
+  const char *psiEnv = getenv("SCHR_PSI");
+  const int order = orderEnv ? stoi(orderEnv) : 2;
+  const int threads = threadsEnv ? stoi(threadsEnv) : 0;
+  const Pinning pinning =
+      !pinEnv ? NO_PINNING
+              : strcmp(pinEnv, "cpu") == 0
+                    ? PIN_CPUS
+                    : strcmp(pinEnv, "node") == 0 ? PIN_NODES : NO_PINNING;
 
   SDL_Window* window;
   SDL_Renderer* renderer;
   SDL_Init(SDL_INIT_VIDEO); // TODO: Handle error.
-  SDL_CreateWindowAndRenderer(width * scale, height * scale, 0, &window,
-                              &renderer);
-  SDL_SetWindowTitle(window, "Schrödinger-Poisson equation");
-  SDL_Texture *texture =
-      SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888,
-                        SDL_TEXTUREACCESS_STREAMING, width, height);
-  SDL_RenderSetScale(renderer, scale, scale);
-  static Uint32 *pixels = new Uint32[height * width];
-  Wave wave(width, height);
+  const int windowWidth = width * scale;
+  const int windowHeight = height * scale;
+  // Never draw more pixels than there are cells or window pixels.
+  const int textureWidth = min(width, windowWidth);
+  const int textureHeight = min(height, windowHeight);
+  SDL_CreateWindowAndRenderer(windowWidth, windowHeight, 0, &window, &renderer);
+  SDL_SetWindowTitle(window, WINDOW_TITLE);
+  SDL_Texture *texture = SDL_CreateTexture(
+      renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+      textureWidth, textureHeight);
+  static Uint32 *pixels = new Uint32[textureHeight * textureWidth];
+  Wave wave(width, height, order, threads, pinning);
+  // The amplitude is limited while the user draws the wave, but not for a
+  // loaded or computed ground state, which would no longer be stationary.
+  bool limitAmplitude = true;
+  if (psiEnv) {
+    if (wave.loadPsi(psiEnv)) {
+      limitAmplitude = false;
+    } else {
+      cerr << "Could not load the wave function from " << psiEnv << endl;
+    }
+  }
   Bencher bencher(bench);
   int colorf = 0;
+  const Viewport fullView = {0.0, 0.0, static_cast<double>(width),
+                             static_cast<double>(height)};
+  Viewport view = fullView;
+  Reduction reduction = AVERAGE;
 
   SDL_Event event;
   bool running = true;
@@ -95,15 +164,31 @@ int main(int argc, char *argv[]) {
     while (SDL_PollEvent(&event)) {
       switch (event.type) {
       case SDL_MOUSEMOTION:
-        addBump(&wave, event.motion.x, event.motion.y, scale,
-                event.motion.state & SDL_BUTTON_LMASK,
-                event.motion.state & SDL_BUTTON_RMASK);
+        if (addBump(&wave,
+                    toCell(event.motion.x, windowWidth, view.x, view.width),
+                    toCell(event.motion.y, windowHeight, view.y, view.height),
+                    event.motion.state & SDL_BUTTON_LMASK,
+                    event.motion.state & SDL_BUTTON_RMASK)) {
+          limitAmplitude = true;
+        }
         break;
       case SDL_MOUSEBUTTONDOWN:
-        addBump(&wave, event.motion.x, event.motion.y, scale,
-                event.button.button == SDL_BUTTON_LMASK,
-                event.button.button == SDL_BUTTON_RMASK);
+        if (addBump(&wave,
+                    toCell(event.motion.x, windowWidth, view.x, view.width),
+                    toCell(event.motion.y, windowHeight, view.y, view.height),
+                    event.button.button == SDL_BUTTON_LMASK,
+                    event.button.button == SDL_BUTTON_RMASK)) {
+          limitAmplitude = true;
+        }
         break;
+      case SDL_MOUSEWHEEL: {
+        int mx, my;
+        SDL_GetMouseState(&mx, &my);
+        zoomView(&view, event.wheel.y > 0 ? 0.8 : 1.25,
+                 toCell(mx, windowWidth, view.x, view.width),
+                 toCell(my, windowHeight, view.y, view.height), width, height);
+        break;
+      }
       case SDL_KEYDOWN:
         switch (event.key.keysym.sym) {
         case SDLK_ESCAPE:
@@ -112,6 +197,81 @@ int main(int argc, char *argv[]) {
         case SDLK_c:
           colorf ^= 1;
           break;
+        case SDLK_o: {
+          const Observables &o = wave.observables();
+          cout << "step " << o.step << ": energy " << o.energy << " J (kinetic "
+               << o.kinetic << ", potential " << o.potential << ", self "
+               << o.selfEnergy << "), center (" << o.centerX << ", "
+               << o.centerY << ") m, momentum (" << o.momentumX << ", "
+               << o.momentumY << ") +- " << o.momentumSpread << " kg m/s"
+               << endl;
+          break;
+        }
+        case SDLK_g: {
+          // Show the progress regularly, and stop on Escape, G or closing the
+          // window.
+          GroundStateConfig config;
+          Uint32 lastFrame = SDL_GetTicks();
+          config.progress = [&](const GroundStateResult &result) {
+            if (SDL_GetTicks() - lastFrame < GROUND_STATE_FRAME_MS) {
+              return true;
+            }
+            lastFrame = SDL_GetTicks();
+            bool proceed = true;
+            SDL_Event searchEvent;
+            while (SDL_PollEvent(&searchEvent)) {
+              if (searchEvent.type == SDL_QUIT) {
+                running = false;
+                proceed = false;
+              } else if (searchEvent.type == SDL_KEYDOWN &&
+                         (searchEvent.key.keysym.sym == SDLK_ESCAPE ||
+                          searchEvent.key.keysym.sym == SDLK_g)) {
+                proceed = false;
+              }
+            }
+            const string title =
+                "Ground state: iteration " + to_string(result.iterations) +
+                ", residual " + to_string(result.residual);
+            SDL_SetWindowTitle(window, title.c_str());
+            wave.draw(pixels, textureWidth, textureHeight, view, reduction,
+                      colorf == 0 ? toColor0 : toColor1);
+            present(renderer, texture, pixels, textureWidth);
+            return proceed;
+          };
+          const GroundStateResult result = wave.findGroundState(config);
+          SDL_SetWindowTitle(window, WINDOW_TITLE);
+          // An interrupted search leaves an arbitrary state, that is still
+          // limited like any other.
+          if (result.converged) {
+            limitAmplitude = false;
+          }
+          cout << "ground state " << (result.converged ? "" : "not ")
+               << "found after " << result.iterations << " iterations: energy "
+               << result.energy << " J, residual " << result.residual << endl;
+          if (result.converged && !wave.savePsi(GROUND_STATE_FILE)) {
+            cerr << "Could not save the wave function to " << GROUND_STATE_FILE
+                 << endl;
+          }
+          break;
+        }
+        case SDLK_m:
+          reduction = reduction == AVERAGE ? MAX_AMPLITUDE : AVERAGE;
+          break;
+        case SDLK_HOME:
+          view = fullView;
+          break;
+        case SDLK_LEFT:
+          view.x = max(view.x - 0.1 * view.width, 0.0);
+          break;
+        case SDLK_RIGHT:
+          view.x = min(view.x + 0.1 * view.width, width - view.width);
+          break;
+        case SDLK_UP:
+          view.y = max(view.y - 0.1 * view.height, 0.0);
+          break;
+        case SDLK_DOWN:
+          view.y = min(view.y + 0.1 * view.height, height - view.height);
+          break;
         }
         break;
       case SDL_QUIT:
@@ -119,21 +279,22 @@ int main(int argc, char *argv[]) {
         break;
       }
     }
-    wave.normalize();
+    wave.normalize(limitAmplitude);
     for (int i = 0; i < skipFrames; i++) {
       wave.evolve();
     }
     bencher.bench("Calculation");
-    wave.draw(pixels, colorf == 0 ? toColor0 : toColor1);
+    wave.draw(pixels, textureWidth, textureHeight, view, reduction,
+              colorf == 0 ? toColor0 : toColor1);
     bencher.bench("Color coding");
-    SDL_UpdateTexture(texture, nullptr, pixels, width * sizeof(Uint32));
-    SDL_RenderClear(renderer);
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-    SDL_RenderPresent(renderer);
+    present(renderer, texture, pixels, textureWidth);
     bencher.bench("Rendering");
   }
 
   bencher.print();
+  if (bench) {
+    cout << wave.placementStats() << endl;
+  }
 
   SDL_DestroyWindow(window);
   SDL_Quit();